@@ -0,0 +1,268 @@
+#pragma once
+
+#include "treent/TreeComponent.h"
+#include "Components.h"
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace treent
+{
+
+/// Axis-aligned box. Default-constructed bounds are empty and grow with include().
+struct Bounds
+{
+	Bounds() = default;
+	Bounds(const ci::vec2 &min, const ci::vec2 &max)
+	: min(min),
+	  max(max)
+	{}
+
+	bool		empty() const { return min.x > max.x || min.y > max.y; }
+	/// Grow to cover \a other.
+	void		include(const Bounds &other);
+	/// Smallest box around our corners mapped through \a transform, any type with transformPoint().
+	template <typename T>
+	Bounds	transformed(const T &transform) const;
+	bool		intersects(const Bounds &other) const { return ! empty() && ! other.empty() && min.x <= other.max.x && other.min.x <= max.x && min.y <= other.max.y && other.min.y <= max.y; }
+	bool		contains(const ci::vec2 &point) const { return min.x <= point.x && point.x <= max.x && min.y <= point.y && point.y <= max.y; }
+
+	ci::vec2	min = ci::vec2(std::numeric_limits<float>::max());
+	ci::vec2	max = ci::vec2(-std::numeric_limits<float>::max());
+};
+
+///
+/// Bounding boxes of whole subtrees, so hit testing and culling can reject a branch
+/// with one test instead of testing every leaf.
+///
+/// Each node has content bounds in its own space (the local value). Where that content
+/// ends up comes from the node's TransformC component, so rotation and scale are
+/// accounted for and there is no second position to keep in step. updateBounds() maps
+/// each node's content corners through its world transform and unions the results
+/// bottom-up into root-space subtree boxes:
+///
+/// bounds->setContent(Bounds(ci::vec2(0), size));
+/// BoundsComponent::updateBounds(entities);
+/// BoundsComponent::query(entities, viewport, [] (BoundsComponent &visible) { ... });
+///
+/// setContent() and marking a node's TransformC dirty flag the path above the node, so
+/// updateBounds() only visits changed nodes, the subtrees of moved ones and the paths up
+/// to their roots; clean trees are skipped with one test each. Moved subtrees compose their
+/// poses from their parents' as they go. The bounds trees must mirror the TransformC trees,
+/// as they do for the components of one TreentT, and TransformC components must belong to
+/// their manager's order; TreentT binds them.
+///
+template <typename TransformC>
+struct BoundsComponentT : public TreeComponent<BoundsComponentT<TransformC>, Bounds>
+{
+	using Pose = typename TransformC::World;
+
+	BoundsComponentT() = default;
+	explicit BoundsComponentT(const Bounds &content)
+	: TreeComponent<BoundsComponentT<TransformC>, Bounds>(content)
+	{}
+
+	/// Content boxes aren't inherited; the tree only provides the structure to union over.
+	static Bounds compose(const Bounds &, const Bounds &local) { return local; }
+
+	/// Bounds of this node's own content, in its own space.
+	const Bounds&	content() const { return this->local(); }
+	/// Replace our content bounds and flag the subtree boxes above us for updating.
+	void					setContent(const Bounds &content) { this->setLocal(content); _boundsDirty = true; markPath(); }
+
+	/// Our content in root space, as of the last updateBounds().
+	const Bounds&	worldContent() const { return _box; }
+	/// Our content and all of our descendants' content in root space, as of the last updateBounds().
+	const Bounds&	worldBounds() const { return this->childCount() ? _subtree : _box; }
+
+	/// Bring the root-space boxes of every tree and lone node in \a entities up to date.
+	/// Changes to transforms are tracked from the first call on.
+	static void		updateBounds(entityx::EntityManager &entities);
+	/// Calls \a fn(BoundsComponentT&) for each node, in a tree or alone, whose content in root
+	/// space intersects \a area, skipping subtrees whose bounds miss it. Needs current bounds;
+	/// run updateBounds() first. Points are zero-sized areas.
+	template <typename F>
+	static void		query(entityx::EntityManager &entities, const Bounds &area, F &&fn);
+
+private:
+	/// Flag us and our ancestors, up to the first one already flagged, as needing a visit.
+	void					markPath();
+	/// Dirty observer of the TransformC order; the context is our EntityManager.
+	static void		transformDirty(void *context, TransformC &transform);
+	/// Our world transform: \a parent composed with our TransformC's local value, or \a parent when we have none.
+	Pose					pose(entityx::EntityManager &entities, const Pose &parent) const;
+
+	Bounds		_box;
+	Bounds		_subtree;
+	/// World transform our _box was made from.
+	Pose			_pose;
+	/// Order generation our boxes were computed in; stale after the topology changes.
+	uint32_t	_boundsGeneration = 0;
+	/// Our content changed.
+	bool			_boundsDirty = true;
+	/// Our transform changed, moving our whole subtree.
+	bool			_moved = true;
+	/// We or a descendant changed.
+	bool			_pathDirty = true;
+};
+
+using BoundsComponent = BoundsComponentT<TransformComponent>;
+using AffineBoundsComponent = BoundsComponentT<Affine2dComponent>;
+
+#pragma mark - Bounds Implementation
+
+inline void Bounds::include(const Bounds &other)
+{
+	if (other.empty()) {
+		return;
+	}
+	min = ci::vec2(std::min(min.x, other.min.x), std::min(min.y, other.min.y));
+	max = ci::vec2(std::max(max.x, other.max.x), std::max(max.y, other.max.y));
+}
+
+template <typename T>
+Bounds Bounds::transformed(const T &transform) const
+{
+	if (empty()) {
+		return *this;
+	}
+	const ci::vec2 corners[] = { min, ci::vec2(max.x, min.y), max, ci::vec2(min.x, max.y) };
+	Bounds result;
+	for (auto &corner : corners) {
+		const auto p = transform.transformPoint(corner);
+		result.include(Bounds(p, p));
+	}
+	return result;
+}
+
+#pragma mark - BoundsComponent Template Implementation
+
+template <typename T>
+void BoundsComponentT<T>::markPath()
+{
+	for (auto node = this; node && ! node->_pathDirty;) {
+		node->_pathDirty = true;
+		auto parent = node->getParent();
+		node = parent ? parent.get() : nullptr;
+	}
+}
+
+template <typename T>
+void BoundsComponentT<T>::transformDirty(void *context, T &transform)
+{
+	auto &entities = *static_cast<entityx::EntityManager*>(context);
+	const auto id = transform.entityId();
+	if (! entities.valid(id)) {
+		return;
+	}
+	auto bounds = entities.component<BoundsComponentT>(id);
+	if (bounds) {
+		bounds->_moved = true;
+		bounds->markPath();
+	}
+}
+
+template <typename T>
+auto BoundsComponentT<T>::pose(entityx::EntityManager &entities, const Pose &parent) const -> Pose
+{
+	auto transform = entities.component<T>(this->entityId());
+	return transform ? T::compose(parent, transform->local()) : parent;
+}
+
+template <typename T>
+void BoundsComponentT<T>::updateBounds(entityx::EntityManager &entities)
+{
+	TreeOrder<T>::instance(entities).observeDirty(&transformDirty, &entities);
+	auto &order = TreeOrder<BoundsComponentT>::instance(entities);
+	order.update(entities);
+
+	const auto &nodes = order.nodes();
+	const auto &parents = order.parents();
+	const auto &sizes = order.subtreeSizes();
+	const auto generation = order.generation();
+	const auto npos = TreeOrder<BoundsComponentT>::npos;
+
+	// Walk down the flagged paths, remaking the boxes of changed nodes and of everything
+	// within moved subtrees. Trees of a rebuilt order are remade whole.
+	static thread_local std::vector<uint32_t> sVisited;
+	sVisited.clear();
+	size_t movedEnd = 0;
+	for (size_t i = 0; i < nodes.size();) {
+		auto node = nodes[i];
+		const auto parent = parents[i];
+		if (parent == npos && node->_boundsGeneration != generation) {
+			movedEnd = std::max(movedEnd, i + sizes[i]);
+		}
+		const bool moved = i < movedEnd || node->_moved;
+		if (! moved && ! node->_pathDirty && ! node->_boundsDirty) {
+			i += sizes[i];
+			continue;
+		}
+		if (moved) {
+			movedEnd = std::max(movedEnd, i + sizes[i]);
+			node->_pose = node->pose(entities, parent != npos ? nodes[parent]->_pose : Pose());
+		}
+		if (moved || node->_boundsDirty) {
+			node->_box = node->content().transformed(node->_pose);
+		}
+		node->_boundsGeneration = generation;
+		node->_boundsDirty = false;
+		node->_moved = false;
+		node->_pathDirty = false;
+		sVisited.push_back(static_cast<uint32_t>(i));
+		i += 1;
+	}
+
+	// Children follow their parents, so going backwards finishes them first.
+	for (auto v = sVisited.rbegin(); v != sVisited.rend(); ++v) {
+		const auto i = *v;
+		auto node = nodes[i];
+		auto bounds = node->_box;
+		for (auto child = i + 1; child < i + sizes[i]; child += sizes[child]) {
+			bounds.include(nodes[child]->worldBounds());
+		}
+		node->_subtree = bounds;
+	}
+
+	for (auto node : order.lone()) {
+		if (node->_moved) {
+			node->_pose = node->pose(entities, Pose());
+		}
+		if (node->_moved || node->_boundsDirty) {
+			node->_box = node->content().transformed(node->_pose);
+		}
+		node->_boundsDirty = false;
+		node->_moved = false;
+		node->_pathDirty = false;
+	}
+}
+
+template <typename T>
+template <typename F>
+void BoundsComponentT<T>::query(entityx::EntityManager &entities, const Bounds &area, F &&fn)
+{
+	auto &order = TreeOrder<BoundsComponentT>::instance(entities);
+	order.update(entities);
+	const auto &nodes = order.nodes();
+	const auto &sizes = order.subtreeSizes();
+
+	for (size_t i = 0; i < nodes.size();) {
+		auto node = nodes[i];
+		if (! node->worldBounds().intersects(area)) {
+			i += sizes[i];
+			continue;
+		}
+		if (node->_box.intersects(area)) {
+			fn(*node);
+		}
+		i += 1;
+	}
+
+	for (auto node : order.lone()) {
+		if (node->_box.intersects(area)) {
+			fn(*node);
+		}
+	}
+}
+
+} // namespace treent
@@ -2,24 +2,211 @@
 #pragma once
 
 #include "treent/TreeComponent.h"
+#include "treent/detail/Simd.h"
+#include <cmath>
 
 namespace treent
 {
 
-struct TransformComponent : public TreeComponent<TransformComponent>
+/// Position and rotation, either relative to a parent (local) or to the root (world).
+struct Transform
 {
-	void compose (const TransformComponent &other) { _position += other._position; _rotation += other._rotation; }
+	Transform() = default;
+	Transform(const ci::vec2 &position, float rotation)
+	: position(position),
+	  rotation(rotation)
+	{}
 
-	ci::vec2	_position;
-	float			_rotation;
+	/// Rotate \a point by our rotation, then move it by our position.
+	ci::vec2	transformPoint(const ci::vec2 &point) const;
+
+	ci::vec2	position;
+	float			rotation = 0.0f;
+};
+
+/// Opacity and color. Alpha is multiplied down the tree; color is not inherited.
+struct Style
+{
+	Style() = default;
+	Style(float alpha, const ci::vec3 &color)
+	: alpha(alpha),
+	  color(color)
+	{}
+
+	float			alpha = 1.0f;
+	ci::vec3	color = ci::vec3(1.0f);
+};
+
+/// 2d affine transform, stored as the top two rows of a 3x3 matrix in row-major order:
+/// | m[0] m[1] m[2] |
+/// | m[3] m[4] m[5] |
+/// Unlike Transform, composing two of them rotates and scales the child's position too.
+struct Affine2d
+{
+	Affine2d() = default;
+	/// Scale, then rotate by \a rotation radians, then translate by \a position.
+	static Affine2d trs(const ci::vec2 &position, float rotation, const ci::vec2 &scale = ci::vec2(1.0f));
+
+	Affine2d	operator * (const Affine2d &rhs) const;
+	ci::vec2	transformPoint(const ci::vec2 &point) const { return ci::vec2(m[0] * point.x + m[1] * point.y + m[2], m[3] * point.x + m[4] * point.y + m[5]); }
+	ci::vec2	translation() const { return ci::vec2(m[2], m[5]); }
+
+	float			m[6] = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
 };
 
-struct StyleComponent : public TreeComponent<StyleComponent>
+struct TransformComponent : public TreeComponent<TransformComponent, Transform>
+{
+	TransformComponent() = default;
+	explicit TransformComponent(const Transform &local)
+	: TreeComponent(local)
+	{}
+
+	static Transform compose(const Transform &parent, const Transform &local) { return Transform(parent.position + local.position, parent.rotation + local.rotation); }
+};
+
+struct StyleComponent : public TreeComponent<StyleComponent, Style>
+{
+	StyleComponent() = default;
+	explicit StyleComponent(const Style &local)
+	: TreeComponent(local)
+	{}
+
+	static Style compose(const Style &parent, const Style &local) { return Style(parent.alpha * local.alpha, local.color); }
+};
+
+/// Full 2d affine hierarchy: world = parent world * local.
+struct Affine2dComponent : public TreeComponent<Affine2dComponent, Affine2d>
+{
+	Affine2dComponent() = default;
+	explicit Affine2dComponent(const Affine2d &local)
+	: TreeComponent(local)
+	{}
+
+	static Affine2d compose(const Affine2d &parent, const Affine2d &local) { return parent * local; }
+};
+
+#pragma mark - Transform Implementation
+
+inline ci::vec2 Transform::transformPoint(const ci::vec2 &point) const
 {
-	void compose(const StyleComponent &other) { _alpha *= other._alpha; }
+	const float c = std::cos(rotation);
+	const float s = std::sin(rotation);
+	return ci::vec2(position.x + c * point.x - s * point.y, position.y + s * point.x + c * point.y);
+}
+
+#pragma mark - Affine2d Implementation
+
+inline Affine2d Affine2d::trs(const ci::vec2 &position, float rotation, const ci::vec2 &scale)
+{
+	const float c = std::cos(rotation);
+	const float s = std::sin(rotation);
+	Affine2d a;
+	a.m[0] = c * scale.x; a.m[1] = -s * scale.y; a.m[2] = position.x;
+	a.m[3] = s * scale.x; a.m[4] = c * scale.y;  a.m[5] = position.y;
+	return a;
+}
+
+inline Affine2d Affine2d::operator * (const Affine2d &rhs) const
+{
+	// Same order of operations as the batch kernel, so both paths agree exactly.
+	Affine2d out;
+	for (int r = 0; r < 2; ++r) {
+		for (int c = 0; c < 3; ++c) {
+			float sum = (c == 2) ? m[r * 3 + 2] : 0.0f;
+			sum += m[r * 3 + 0] * rhs.m[0 * 3 + c];
+			sum += m[r * 3 + 1] * rhs.m[1 * 3 + c];
+			out.m[r * 3 + c] = sum;
+		}
+	}
+	return out;
+}
+
+#pragma mark - Batch Composition
+
+template <>
+struct BatchCompose<TransformComponent>
+{
+	static const size_t FieldCount = 3;
+
+	static void load(const Transform &t, float *const *lanes, size_t i)
+	{
+		lanes[0][i] = t.position.x;
+		lanes[1][i] = t.position.y;
+		lanes[2][i] = t.rotation;
+	}
+
+	static void store(Transform &t, const float *const *lanes, size_t i)
+	{
+		t.position = ci::vec2(lanes[0][i], lanes[1][i]);
+		t.rotation = lanes[2][i];
+	}
+
+	static void compose(float *const *world, const float *const *parent, const float *const *local, size_t count)
+	{
+		for (size_t f = 0; f < FieldCount; ++f) {
+			detail::simd::add(world[f], parent[f], local[f], count);
+		}
+	}
+};
+
+template <>
+struct BatchCompose<StyleComponent>
+{
+	static const size_t FieldCount = 4;
+
+	static void load(const Style &s, float *const *lanes, size_t i)
+	{
+		lanes[0][i] = s.alpha;
+		lanes[1][i] = s.color.x;
+		lanes[2][i] = s.color.y;
+		lanes[3][i] = s.color.z;
+	}
+
+	static void store(Style &s, const float *const *lanes, size_t i)
+	{
+		s.alpha = lanes[0][i];
+		s.color = ci::vec3(lanes[1][i], lanes[2][i], lanes[3][i]);
+	}
+
+	static void compose(float *const *world, const float *const *parent, const float *const *local, size_t count)
+	{
+		detail::simd::multiply(world[0], parent[0], local[0], count);
+		for (size_t f = 1; f < FieldCount; ++f) {
+			detail::simd::copy(world[f], local[f], count);
+		}
+	}
+};
+
+template <>
+struct BatchCompose<Affine2dComponent>
+{
+	static const size_t FieldCount = 6;
+
+	static void load(const Affine2d &a, float *const *lanes, size_t i)
+	{
+		for (size_t f = 0; f < FieldCount; ++f) {
+			lanes[f][i] = a.m[f];
+		}
+	}
+
+	static void store(Affine2d &a, const float *const *lanes, size_t i)
+	{
+		for (size_t f = 0; f < FieldCount; ++f) {
+			a.m[f] = lanes[f][i];
+		}
+	}
 
-	float 		_alpha;
-	ci::vec3	_color;
+	/// One lane per matrix element: world[r][c] = parent[r][0] * local[0][c] + parent[r][1] * local[1][c] (+ parent[r][2] for the translation column).
+	static void compose(float *const *world, const float *const *parent, const float *const *local, size_t count)
+	{
+		for (size_t r = 0; r < 2; ++r) {
+			const float *a[] = { parent[r * 3 + 0], parent[r * 3 + 1] };
+			for (size_t c = 0; c < 3; ++c) {
+				const float *b[] = { local[0 * 3 + c], local[1 * 3 + c] };
+				detail::simd::sumOfProducts(world[r * 3 + c], a, b, 2, (c == 2) ? parent[r * 3 + 2] : nullptr, count);
+			}
+		}
+	}
 };
 
 } // namespace treent
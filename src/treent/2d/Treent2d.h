@@ -2,11 +2,29 @@
 #pragma once
 
 #include "treent/Treent.h"
+#include "treent/TreeCommands.h"
+#include "treent/ScopedTreent.h"
+#include "treent/TreeSnapshot.h"
+#include "treent/TreeStream.h"
+#include "treent/TreeView.h"
 #include "Components.h"
+#include "Bounds.h"
 
 namespace treent
 {
 
 using Treent = TreentT<TransformComponent, StyleComponent>;
+using TreentView = TreentViewT<TransformComponent, StyleComponent>;
+using ScopedTreent = ScopedTreentT<TransformComponent, StyleComponent>;
+using ScopedTreentGroup = ScopedTreentGroupT<TransformComponent, StyleComponent>;
+using TreeCommandBuffer = TreeCommandBufferT<TransformComponent, StyleComponent>;
+using TreeSnapshot = TreeSnapshotT<TransformComponent, StyleComponent>;
+using TreeStream = TreeStreamT<TransformComponent, StyleComponent>;
+/// Treents that also keep subtree bounds for hit testing and culling.
+using BoundedTreent = TreentT<TransformComponent, StyleComponent, BoundsComponent>;
+/// Treents with full affine transforms (rotation and scale carry into child positions).
+using AffineTreent = TreentT<Affine2dComponent, StyleComponent>;
+/// Affine treents that also keep subtree bounds.
+using BoundedAffineTreent = TreentT<Affine2dComponent, StyleComponent, AffineBoundsComponent>;
 
 } // namespace treent
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "treent/TreeComponent.h"
+#include "treent/detail/Simd.h"
+
+namespace treent
+{
+
+/// 3d affine transform, stored as the top three rows of a 4x4 matrix in row-major order.
+/// The bottom row is always 0 0 0 1, so it is left out; m[3], m[7] and m[11] hold the translation.
+/// Values stay whole, one 48-byte record per node in TreeOrder's dense arrays, rather than
+/// split into per-element lanes: compose(), worldValue() and TreeSpan all read and write
+/// a matrix at a time. descendLevels() copies a level at a time into lanes for its SIMD
+/// kernels (see BatchCompose); TreentBench's affine3d case times both layouts' passes.
+struct Affine3d
+{
+	Affine3d() = default;
+	/// Scale, then rotate by the unit quaternion \a orientation, then translate by \a position.
+	static Affine3d trs(const ci::vec3 &position, const ci::quat &orientation, const ci::vec3 &scale = ci::vec3(1.0f));
+
+	Affine3d	operator * (const Affine3d &rhs) const;
+	ci::vec3	transformPoint(const ci::vec3 &point) const;
+	ci::vec3	translation() const { return ci::vec3(m[3], m[7], m[11]); }
+
+	float			m[12] = { 1.0f, 0.0f, 0.0f, 0.0f,
+									0.0f, 1.0f, 0.0f, 0.0f,
+									0.0f, 0.0f, 1.0f, 0.0f };
+};
+
+/// Reference 3d hierarchy: world = parent world * local.
+struct Affine3dComponent : public TreeComponent<Affine3dComponent, Affine3d>
+{
+	Affine3dComponent() = default;
+	explicit Affine3dComponent(const Affine3d &local)
+	: TreeComponent(local)
+	{}
+
+	static Affine3d compose(const Affine3d &parent, const Affine3d &local) { return parent * local; }
+};
+
+#pragma mark - Affine3d Implementation
+
+inline Affine3d Affine3d::trs(const ci::vec3 &position, const ci::quat &orientation, const ci::vec3 &scale)
+{
+	const float w = orientation.w, x = orientation.x, y = orientation.y, z = orientation.z;
+	Affine3d a;
+	a.m[0] = (1.0f - 2.0f * (y * y + z * z)) * scale.x;
+	a.m[1] = 2.0f * (x * y - w * z) * scale.y;
+	a.m[2] = 2.0f * (x * z + w * y) * scale.z;
+	a.m[3] = position.x;
+	a.m[4] = 2.0f * (x * y + w * z) * scale.x;
+	a.m[5] = (1.0f - 2.0f * (x * x + z * z)) * scale.y;
+	a.m[6] = 2.0f * (y * z - w * x) * scale.z;
+	a.m[7] = position.y;
+	a.m[8] = 2.0f * (x * z - w * y) * scale.x;
+	a.m[9] = 2.0f * (y * z + w * x) * scale.y;
+	a.m[10] = (1.0f - 2.0f * (x * x + y * y)) * scale.z;
+	a.m[11] = position.z;
+	return a;
+}
+
+inline Affine3d Affine3d::operator * (const Affine3d &rhs) const
+{
+	// Same order of operations as the batch kernel, so both paths agree exactly.
+	Affine3d out;
+	for (int r = 0; r < 3; ++r) {
+		for (int c = 0; c < 4; ++c) {
+			float sum = (c == 3) ? m[r * 4 + 3] : 0.0f;
+			sum += m[r * 4 + 0] * rhs.m[0 * 4 + c];
+			sum += m[r * 4 + 1] * rhs.m[1 * 4 + c];
+			sum += m[r * 4 + 2] * rhs.m[2 * 4 + c];
+			out.m[r * 4 + c] = sum;
+		}
+	}
+	return out;
+}
+
+inline ci::vec3 Affine3d::transformPoint(const ci::vec3 &p) const
+{
+	return ci::vec3(m[0] * p.x + m[1] * p.y + m[2] * p.z + m[3],
+									m[4] * p.x + m[5] * p.y + m[6] * p.z + m[7],
+									m[8] * p.x + m[9] * p.y + m[10] * p.z + m[11]);
+}
+
+#pragma mark - Batch Composition
+
+template <>
+struct BatchCompose<Affine3dComponent>
+{
+	static const size_t FieldCount = 12;
+
+	static void load(const Affine3d &a, float *const *lanes, size_t i)
+	{
+		for (size_t f = 0; f < FieldCount; ++f) {
+			lanes[f][i] = a.m[f];
+		}
+	}
+
+	static void store(Affine3d &a, const float *const *lanes, size_t i)
+	{
+		for (size_t f = 0; f < FieldCount; ++f) {
+			a.m[f] = lanes[f][i];
+		}
+	}
+
+	/// One lane per matrix element, so each output element is a three-term dot product across the level.
+	static void compose(float *const *world, const float *const *parent, const float *const *local, size_t count)
+	{
+		for (size_t r = 0; r < 3; ++r) {
+			const float *a[] = { parent[r * 4 + 0], parent[r * 4 + 1], parent[r * 4 + 2] };
+			for (size_t c = 0; c < 4; ++c) {
+				const float *b[] = { local[0 * 4 + c], local[1 * 4 + c], local[2 * 4 + c] };
+				detail::simd::sumOfProducts(world[r * 4 + c], a, b, 3, (c == 3) ? parent[r * 4 + 3] : nullptr, count);
+			}
+		}
+	}
+};
+
+} // namespace treent
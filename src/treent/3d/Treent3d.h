@@ -0,0 +1,19 @@
+#pragma once
+
+#include "treent/Treent.h"
+#include "treent/TreeCommands.h"
+#include "treent/ScopedTreent.h"
+#include "treent/TreeSnapshot.h"
+#include "treent/TreeView.h"
+#include "Components.h"
+
+namespace treent
+{
+
+using Treent3d = TreentT<Affine3dComponent>;
+using TreentView3d = TreentViewT<Affine3dComponent>;
+using ScopedTreent3d = ScopedTreentT<Affine3dComponent>;
+using TreeCommandBuffer3d = TreeCommandBufferT<Affine3dComponent>;
+using TreeSnapshot3d = TreeSnapshotT<Affine3dComponent>;
+
+} // namespace treent
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace treent
+{
+
+///
+/// Opt-in description of a tree component whose compose() can be expressed element-wise
+/// over float fields. Specialize for a component to enable TreeOrder::descendLevels(),
+/// which composes a whole depth level of the forest at a time with SIMD kernels.
+///
+/// A specialization provides:
+///
+/// static const size_t FieldCount;
+///   The number of floats in the component's Local and World values.
+/// static void load(const Local &local, float *const *lanes, size_t i);
+/// static void load(const World &world, float *const *lanes, size_t i);
+///   Write the fields of a value to lanes[field][i].
+/// static void store(World &world, const float *const *lanes, size_t i);
+///   Read lanes[field][i] back into a World value.
+/// static void compose(float *const *world, const float *const *parentWorld, const float *const *local, size_t count);
+///   Compose count values at once, lane by lane. See detail/Simd.h for kernels.
+///
+/// If Local and World are the same type, a single load() covers both.
+///
+template <typename Component>
+struct BatchCompose;
+
+} // namespace treent
@@ -28,37 +28,213 @@
 #pragma once
 
 #include "entityx/Entity.h"
+#include "NodeHandle.h"
+#include "ParentComponent.h"
+#include "TreeStats.h"
+#include "detail/SmallVector.h"
 #include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+/// Number of children stored inline in child lists before they move to the heap. At least 1.
+#ifndef TREENT_INLINE_CHILDREN
+  #define TREENT_INLINE_CHILDREN 4
+#endif
 
 namespace treent
 {
 
+///
+/// Owns a list of child entities, destroying them along with itself.
+/// Children are stored as NodeHandles and resolved against the EntityManager given at
+/// construction, so a list costs half of what a list of entityx::Entity would.
+/// A default-constructed component, e.g. from assign<ChildrenComponent>(), learns its
+/// manager from the first TreentT that wraps or links its entity.
+/// Removing a child leaves an empty entry behind instead of shifting its later siblings down;
+/// children() compacts the list the next time it is read. Together with the index each
+/// child's ParentComponent remembers, that makes removal O(1) and removing every child
+/// one at a time linear rather than quadratic.
+///
 struct ChildrenComponent : public entityx::Component<ChildrenComponent>
 {
+  using Handles = detail::SmallVector<NodeHandle, TREENT_INLINE_CHILDREN>;
+  class ChildList;
+
+  /// Manager resolved on first use by TreentT; see setEntities().
   ChildrenComponent() = default;
+  /// Children are created in and resolved against \a entities.
+  explicit ChildrenComponent(entityx::EntityManager &entities)
+  : _entities(&entities)
+  {}
   ~ChildrenComponent();
 
+  /// The manager our children are resolved against, or nullptr until it is known.
+  entityx::EntityManager* entities() const { return _entities; }
+  /// Resolve children against \a entities from now on, if we didn't know our manager yet.
+  void setEntities(entityx::EntityManager &entities) { if (! _entities) { _entities = &entities; } }
+
   /// Add a child to be managed by this ChildrenComponent. It will be destroyed when this component is destroyed.
-  void addChild(const entityx::Entity &child) { _children.push_back(child); }
+  /// Returns the child's index, which removeChild() accepts as a hint.
+  uint32_t addChild(const entityx::Entity &child);
   /// Removes a child from management. Does not destroy the child.
-  void removeChild(const entityx::Entity &child);
+  /// When \a hint is the index addChild() returned, removal is O(1).
+  void removeChild(const entityx::Entity &child, uint32_t hint = ParentComponent::npos);
+
+  /// Live children in the order they were added.
+  ChildList        children();
+  size_t           size() const { return _children.size() - _holes; }
+  void             reserve(size_t count) { _children.reserve(count); }
+  void             shrink() { compact(); _children.shrink_to_fit(); }
+  /// Forget every child without destroying them.
+  void             clear() { _children.clear(); _holes = 0; }
+
+private:
+  /// Close the gaps left by removeChild() and refresh the children's index hints.
+  void compact();
+
+  entityx::EntityManager *_entities = nullptr;
+  Handles                 _children;
+  uint32_t                _holes = 0;
+};
+
+///
+/// A ChildrenComponent's children, read as entities.
+/// Iterators resolve each handle as it is dereferenced, so they yield Entities by value.
+/// Valid until the list is next changed.
+///
+class ChildrenComponent::ChildList
+{
+public:
+  class const_iterator
+  {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = entityx::Entity;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const entityx::Entity*;
+    using reference = entityx::Entity;
+
+    const_iterator() = default;
+    const_iterator(entityx::EntityManager *entities, const NodeHandle *handle)
+    : _entities(entities),
+      _handle(handle)
+    {}
+
+    entityx::Entity operator * () const { return _handle->entity(*_entities); }
+    entityx::Entity operator [] (difference_type n) const { return _handle[n].entity(*_entities); }
+
+    const_iterator& operator ++ () { ++_handle; return *this; }
+    const_iterator& operator -- () { --_handle; return *this; }
+    const_iterator  operator ++ (int) { auto copy = *this; ++_handle; return copy; }
+    const_iterator  operator -- (int) { auto copy = *this; --_handle; return copy; }
+    const_iterator& operator += (difference_type n) { _handle += n; return *this; }
+    const_iterator& operator -= (difference_type n) { _handle -= n; return *this; }
+    const_iterator  operator + (difference_type n) const { return const_iterator(_entities, _handle + n); }
+    const_iterator  operator - (difference_type n) const { return const_iterator(_entities, _handle - n); }
+    difference_type operator - (const const_iterator &other) const { return _handle - other._handle; }
+
+    bool operator == (const const_iterator &other) const { return _handle == other._handle; }
+    bool operator != (const const_iterator &other) const { return _handle != other._handle; }
+    bool operator < (const const_iterator &other) const { return _handle < other._handle; }
+
+  private:
+    entityx::EntityManager *_entities = nullptr;
+    const NodeHandle       *_handle = nullptr;
+  };
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  ChildList(entityx::EntityManager *entities, const Handles &handles)
+  : _entities(entities),
+    _handles(handles)
+  {}
+
+  const_iterator          begin() const { return const_iterator(_entities, _handles.data()); }
+  const_iterator          end() const { return const_iterator(_entities, _handles.data() + _handles.size()); }
+  const_reverse_iterator  rbegin() const { return const_reverse_iterator(end()); }
+  const_reverse_iterator  rend() const { return const_reverse_iterator(begin()); }
 
-  std::vector<entityx::Entity>  _children;
+  size_t          size() const { return _handles.size(); }
+  bool            empty() const { return _handles.empty(); }
+  entityx::Entity operator [] (size_t i) const { return _handles[i].entity(*_entities); }
+
+private:
+  entityx::EntityManager *_entities;
+  const Handles          &_handles;
 };
 
+#pragma mark - ChildrenComponent Implementation
+
 inline ChildrenComponent::~ChildrenComponent()
 {
-  for (auto &e : _children) {
+  for (auto &handle : _children) {
+		auto e = handle.entity(*_entities);
 		if( e ) {
 			e.destroy();
 		}
   }
 }
 
-inline void ChildrenComponent::removeChild(const entityx::Entity &child)
+inline auto ChildrenComponent::children() -> ChildList
+{
+  assert((_entities || _children.empty()) && "ChildrenComponent read before its manager was known.");
+  if (_holes)
+  {
+    compact();
+  }
+  return ChildList(_entities, _children);
+}
+
+inline uint32_t ChildrenComponent::addChild(const entityx::Entity &child)
+{
+  if (_children.size() == _children.capacity())
+  {
+    TREENT_STAT_ADD(childReallocations, 1);
+  }
+  _children.push_back(NodeHandle(child));
+  return static_cast<uint32_t>(_children.size() - 1);
+}
+
+inline void ChildrenComponent::removeChild(const entityx::Entity &child, uint32_t hint)
 {
-  auto begin = std::remove_if(_children.begin(), _children.end(), [&](const entityx::Entity &e) { return e == child; });
+  const NodeHandle handle(child);
+  if (hint < _children.size() && _children[hint] == handle)
+  {
+    if (hint == _children.size() - 1)
+    {
+      _children.pop_back();
+    }
+    else
+    {
+      _children[hint] = NodeHandle();
+      _holes += 1;
+    }
+    return;
+  }
+
+  auto begin = std::remove(_children.begin(), _children.end(), handle);
   _children.erase(begin, _children.end());
 }
 
+inline void ChildrenComponent::compact()
+{
+  uint32_t next = 0;
+  for (auto &handle : _children)
+  {
+    auto e = handle.entity(*_entities);
+    if (e)
+    {
+      auto parent = e.component<ParentComponent>();
+      if (parent)
+      {
+        parent->_index = next;
+      }
+      _children[next++] = handle;
+    }
+  }
+  _children.erase(_children.begin() + next, _children.end());
+  _holes = 0;
+}
+
 } // namespace treent
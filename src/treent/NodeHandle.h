@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+#include "entityx/Entity.h"
+
+namespace treent
+{
+
+///
+/// A reference to an entity of an EntityManager known from context.
+/// Holds only the entity's id, index and full version, so it takes half the room of an
+/// entityx::Entity and still notices when its entity has been destroyed, even after the
+/// index has been handed out again.
+/// ChildrenComponent keeps its child lists as NodeHandles and resolves them against its manager.
+///
+class NodeHandle
+{
+public:
+  /// Constructs a null handle.
+  NodeHandle() = default;
+  /// Refers to the entity with \a id, or nothing when \a id is INVALID.
+  explicit NodeHandle(entityx::Entity::Id id)
+  : _id(id)
+  {}
+  explicit NodeHandle(const entityx::Entity &entity)
+  : _id(entity.valid() ? entity.id() : entityx::Entity::INVALID)
+  {}
+
+  bool      null() const { return _id == entityx::Entity::INVALID; }
+
+  /// True iff we were made from \a id.
+  bool      refersTo(entityx::Entity::Id id) const { return _id == id; }
+  /// The id of our entity, or INVALID if it has been destroyed from \a entities.
+  entityx::Entity::Id id(const entityx::EntityManager &entities) const { return entities.valid(_id) ? _id : entityx::Entity::INVALID; }
+  /// Our entity in \a entities, or an invalid Entity if it has been destroyed.
+  entityx::Entity entity(entityx::EntityManager &entities) const;
+
+  bool      operator == (const NodeHandle &other) const { return _id == other._id; }
+  bool      operator != (const NodeHandle &other) const { return _id != other._id; }
+
+private:
+  entityx::Entity::Id _id = entityx::Entity::INVALID;
+};
+
+#pragma mark - NodeHandle Implementation
+
+inline entityx::Entity NodeHandle::entity(entityx::EntityManager &entities) const
+{
+  return entities.valid(_id) ? entityx::Entity(&entities, _id) : entityx::Entity();
+}
+
+} // namespace treent
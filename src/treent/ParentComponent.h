@@ -28,12 +28,16 @@
 #pragma once
 
 #include "entityx/Entity.h"
+#include "NodeHandle.h"
+#include <cstdint>
 
 namespace treent
 {
 
 ///
 /// Stores a reference to a parent entity.
+/// The parent is kept as a NodeHandle, since it always belongs to our own manager, and
+/// resolved against the manager of our ChildrenComponent; see TreentT::parentOf().
 /// TODO: perhaps store template type information so we can automatically (and optionally) detach on destruction.
 ///
 struct ParentComponent : public entityx::Component<ParentComponent>
@@ -43,7 +47,11 @@ struct ParentComponent : public entityx::Component<ParentComponent>
   : _parent(parent)
   {}
 
-  entityx::Entity _parent;
+  static const uint32_t npos = UINT32_MAX;
+
+  NodeHandle      _parent;
+  /// Where we sit in our parent's ChildrenComponent list. A hint; may be stale.
+  uint32_t        _index = npos;
 };
 
 } // namespace treent
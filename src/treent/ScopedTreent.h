@@ -28,53 +28,147 @@
 #pragma once
 
 #include "Treent.h"
+#include <vector>
 
 namespace treent
 {
-/*
+
 ///
-/// ScopedTreents destroy their composed treent when falling out of scope.
-/// They are move-only types.
+/// ScopedTreents destroy their composed treent, along with its descendants, when falling out of scope.
+/// They are move-only types, and as cheap to move as a plain Treent: an entity and a manager pointer,
+/// with no vtable.
 /// Use these iff you need to store some member data that won't fit in a component.
 ///
 template <typename ... T>
 class ScopedTreentT : public TreentT<T...>
 {
 public:
-  ScopedTreentT() = default;
+  using Treent = TreentT<T...>;
 
-  explicit ScopedTreentT(const entityx::Entity &entity)
-  : TreentT<T...>(entity)
+  /// Constructs an invalid ScopedTreent, which owns nothing.
+  ScopedTreentT() = default;
+  /// Takes ownership of an entity of the shared EntityManager.
+  explicit ScopedTreentT(const Entity &entity)
+  : Treent(entity)
+  {}
+  /// Takes ownership of an entity of \a entities.
+  ScopedTreentT(EntityManager &entities, const Entity &entity)
+  : Treent(entities, entity)
+  {}
+  /// Takes ownership of an existing Treent's subtree.
+  explicit ScopedTreentT(const Treent &treent)
+  : Treent(treent)
   {}
 
+  /// Factory method for creating a ScopedTreent in \a entities.
+  static ScopedTreentT create(EntityManager &entities) { return ScopedTreentT(entities, entities.create()); }
+
   ScopedTreentT(const ScopedTreentT &other) = delete;
+  ScopedTreentT& operator= (const ScopedTreentT &rhs) = delete;
 
-  ~ScopedTreentT()
+  ScopedTreentT(ScopedTreentT &&other)
+  : Treent(other)
   {
-    if (this->entity())
-    {
-      this->entity().destroy();
-    }
+    other._entity.invalidate();
   }
 
-  ScopedTreentT(ScopedTreentT &&other)
-  : TreentT<T...>(other.entity())
+  ScopedTreentT& operator= (ScopedTreentT &&rhs);
+
+  ~ScopedTreentT() { reset(); }
+
+  /// Destroy the owned subtree now, leaving this ScopedTreent invalid.
+  void    reset();
+  /// Give up ownership without destroying anything. Returns the formerly owned Treent.
+  Treent  release();
+};
+
+///
+/// Owns many subtrees and destroys them all in one batch when falling out of scope.
+/// Cheaper than a ScopedTreent per subtree when tearing down whole screens or levels,
+/// since the subtrees are collected together and destroyed leaves first, as in
+/// TreentT::destroySubtrees(). Move-only.
+///
+template <typename ... T>
+class ScopedTreentGroupT
+{
+public:
+  using Treent = TreentT<T...>;
+
+  ScopedTreentGroupT() = default;
+  ScopedTreentGroupT(const ScopedTreentGroupT &other) = delete;
+  ScopedTreentGroupT& operator= (const ScopedTreentGroupT &rhs) = delete;
+  ScopedTreentGroupT(ScopedTreentGroupT &&other)
+  : _roots(std::move(other._roots))
   {
-    other._entity.invalidate();
+    other._roots.clear();
   }
+  ScopedTreentGroupT& operator= (ScopedTreentGroupT &&rhs);
+
+  ~ScopedTreentGroupT() { reset(); }
+
+  /// Take ownership of \a treent's subtree. Returns \a treent for further setup.
+  const Treent& add(const Treent &treent) { _roots.push_back(treent.entity()); return treent; }
+  /// Take ownership from a ScopedTreent, leaving it invalid.
+  void          add(ScopedTreentT<T...> &&scoped) { _roots.push_back(scoped.release().entity()); }
+  /// Create an unparented Treent in \a entities owned by this group.
+  Treent        create(EntityManager &entities) { return add(Treent::create(entities)); }
 
-  ScopedTreentT& operator= (ScopedTreentT &&rhs)
+  void          reserve(size_t count) { _roots.reserve(count); }
+  /// Number of subtrees owned, including any destroyed by other means since.
+  size_t        size() const { return _roots.size(); }
+  bool          empty() const { return _roots.empty(); }
+
+  /// Destroy every owned subtree now, in one batch.
+  void          reset() { if (! _roots.empty()) { Treent::destroySubtrees(_roots); } }
+  /// Give up ownership of every subtree without destroying them.
+  void          release() { _roots.clear(); }
+
+private:
+  std::vector<Entity> _roots;
+};
+
+#pragma mark - ScopedTreent Template Implementation
+
+template <typename ... T>
+ScopedTreentT<T...>& ScopedTreentT<T...>::operator= (ScopedTreentT &&rhs)
+{
+  if (this != &rhs)
   {
-    if (this->entity())
-    {
-      this->entity().destroy();
-    }
-    this->_entity = rhs._entity;
+    reset();
+    Treent::operator=(rhs);
     rhs._entity.invalidate();
-    return *this;
   }
-private:
+  return *this;
+}
+
+template <typename ... T>
+void ScopedTreentT<T...>::reset()
+{
+  if (this->valid())
+  {
+    this->destroySubtree();
+  }
+  this->_entity.invalidate();
+}
+
+template <typename ... T>
+auto ScopedTreentT<T...>::release() -> Treent
+{
+  Treent treent(*this);
+  this->_entity.invalidate();
+  return treent;
+}
+
+template <typename ... T>
+ScopedTreentGroupT<T...>& ScopedTreentGroupT<T...>::operator= (ScopedTreentGroupT &&rhs)
+{
+  if (this != &rhs)
+  {
+    reset();
+    _roots = std::move(rhs._roots);
+    rhs._roots.clear();
+  }
+  return *this;
+}
 
-};
-*/
 } // namespace treent
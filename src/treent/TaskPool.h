@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace treent
+{
+
+///
+/// A small work-stealing task pool.
+/// Each thread owns a queue; it pushes and pops tasks at the back of its own queue and
+/// steals from the front of other queues when it runs out of work. Tasks may spawn more
+/// tasks, which is how tree propagation forks large subtrees.
+///
+/// The thread calling wait() participates in running tasks, so a pool with zero workers
+/// runs everything on the calling thread.
+///
+class TaskPool
+{
+public:
+  using Task = std::function<void ()>;
+
+  /// Creates a pool with one worker per hardware thread, minus the calling thread.
+  TaskPool(): TaskPool(defaultWorkerCount()) {}
+  explicit TaskPool(size_t workerCount);
+  ~TaskPool();
+
+  TaskPool(const TaskPool &other) = delete;
+  TaskPool& operator= (const TaskPool &rhs) = delete;
+
+  /// Number of threads that run tasks, including the thread calling wait().
+  size_t      threadCount() const { return _workers.size() + 1; }
+
+  /// Queue a task. Safe to call from inside a running task.
+  void        spawn(Task task);
+  /// Run tasks on the calling thread until every spawned task has completed.
+  void        wait();
+
+  static size_t defaultWorkerCount();
+
+private:
+  struct Queue
+  {
+    std::mutex        mutex;
+    std::deque<Task>  tasks;
+  };
+
+  struct Worker
+  {
+    const TaskPool *pool;
+    size_t          index;
+  };
+
+  /// Identifies the pool and queue of the current thread.
+  static Worker& currentWorker();
+  size_t      queueIndex() const;
+
+  bool        runOne(size_t index);
+  bool        pop(size_t index, Task &task);
+  bool        steal(size_t thief, Task &task);
+  void        work(size_t index);
+
+  std::vector<std::unique_ptr<Queue>> _queues;
+  std::vector<std::thread>            _workers;
+  std::atomic<size_t>                 _pending;
+  std::atomic<size_t>                 _queued;
+  std::atomic<bool>                   _quit;
+  std::mutex                          _sleepMutex;
+  std::condition_variable             _wake;
+};
+
+#pragma mark - TaskPool Implementation
+
+inline TaskPool::TaskPool(size_t workerCount)
+: _pending(0),
+  _queued(0),
+  _quit(false)
+{
+  // Queue 0 belongs to threads outside of the pool.
+  for (size_t i = 0; i < workerCount + 1; ++i)
+  {
+    _queues.emplace_back(new Queue);
+  }
+
+  for (size_t i = 1; i < workerCount + 1; ++i)
+  {
+    _workers.emplace_back([this, i] { work(i); });
+  }
+}
+
+inline TaskPool::~TaskPool()
+{
+  wait();
+  {
+    std::lock_guard<std::mutex> lock(_sleepMutex);
+    _quit = true;
+  }
+  _wake.notify_all();
+
+  for (auto &worker : _workers)
+  {
+    worker.join();
+  }
+}
+
+inline size_t TaskPool::defaultWorkerCount()
+{
+  auto threads = std::thread::hardware_concurrency();
+  return (threads > 1) ? threads - 1 : 0;
+}
+
+inline TaskPool::Worker& TaskPool::currentWorker()
+{
+  static thread_local Worker sWorker = { nullptr, 0 };
+  return sWorker;
+}
+
+inline size_t TaskPool::queueIndex() const
+{
+  const auto &worker = currentWorker();
+  return (worker.pool == this) ? worker.index : 0;
+}
+
+inline void TaskPool::spawn(Task task)
+{
+  _pending += 1;
+  {
+    auto &queue = *_queues[queueIndex()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  _queued += 1;
+
+  // Taking the lock orders this notification after any sleeper's predicate check.
+  {
+    std::lock_guard<std::mutex> lock(_sleepMutex);
+  }
+  _wake.notify_one();
+}
+
+inline void TaskPool::wait()
+{
+  const auto index = queueIndex();
+  while (_pending > 0)
+  {
+    if (! runOne(index))
+    {
+      std::unique_lock<std::mutex> lock(_sleepMutex);
+      _wake.wait(lock, [this] { return _pending == 0 || _queued > 0; });
+    }
+  }
+}
+
+inline bool TaskPool::runOne(size_t index)
+{
+  Task task;
+  if (pop(index, task) || steal(index, task))
+  {
+    _queued -= 1;
+    task();
+
+    if (--_pending == 0)
+    {
+      {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+      }
+      _wake.notify_all();
+    }
+    return true;
+  }
+  return false;
+}
+
+inline bool TaskPool::pop(size_t index, Task &task)
+{
+  auto &queue = *_queues[index];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tasks.empty())
+  {
+    return false;
+  }
+  task = std::move(queue.tasks.back());
+  queue.tasks.pop_back();
+  return true;
+}
+
+inline bool TaskPool::steal(size_t thief, Task &task)
+{
+  const auto count = _queues.size();
+  for (size_t i = 1; i < count; ++i)
+  {
+    auto &queue = *_queues[(thief + i) % count];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (! queue.tasks.empty())
+    {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+inline void TaskPool::work(size_t index)
+{
+  currentWorker() = { this, index };
+
+  while (! _quit)
+  {
+    if (! runOne(index))
+    {
+      std::unique_lock<std::mutex> lock(_sleepMutex);
+      _wake.wait(lock, [this] { return _quit || _queued > 0; });
+    }
+  }
+}
+
+} // namespace treent
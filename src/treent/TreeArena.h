@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "detail/Logging.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace treent
+{
+
+///
+/// A per-world pool for the child lists that outgrow their inline storage.
+/// Blocks are carved out of large slabs and recycled through per-size free lists,
+/// so building and tearing down a world doesn't touch the global heap once its
+/// slabs are warm, and worlds on separate threads don't contend for the heap lock.
+///
+/// An arena only serves the thread that holds a Scope for it:
+///
+/// TreeArena arena;
+/// {
+///   TreeArena::Scope scope(arena);
+///   ... build, update and destroy the level ...
+/// }
+/// arena.reset();
+///
+/// Every block remembers where it came from, so lists allocated inside a Scope can
+/// be freed outside of it and vice versa. Blocks larger than MaxBlockSize always
+/// come from the heap. An arena isn't thread-safe; give each world its own.
+///
+class TreeArena
+{
+public:
+  TreeArena()
+  : _free()
+  {}
+  /// The arena must outlive every block allocated from it.
+  ~TreeArena();
+
+  TreeArena(const TreeArena&) = delete;
+  TreeArena& operator=(const TreeArena&) = delete;
+
+  /// Routes child list allocations on the current thread to \a arena for
+  /// the lifetime of the Scope. Scopes nest.
+  class Scope
+  {
+  public:
+    explicit Scope(TreeArena &arena)
+    : _previous(current())
+    { current() = &arena; }
+    ~Scope() { current() = _previous; }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+  private:
+    TreeArena *_previous;
+  };
+
+  /// Returns every slab to the heap at once. Fails, returning false, while any block is in use.
+  bool    reset();
+  /// Number of blocks handed out and not yet freed.
+  size_t  liveBlocks() const { return _live; }
+  /// Bytes of slab memory held by the arena.
+  size_t  reservedBytes() const { return _slabs.size() * SlabSize; }
+
+  /// Allocates \a bytes from the current thread's arena, or the heap outside of a Scope.
+  static void* allocate(size_t bytes);
+  /// Frees a block from allocate(), wherever it came from.
+  static void  deallocate(void *data);
+
+  /// Largest block, including its header, served from slabs.
+  static const size_t MaxBlockSize = 4096;
+  static const size_t SlabSize = 64 * 1024;
+
+private:
+  static const size_t MinBlockShift = 6;
+  static const size_t ClassCount = 7;
+
+  /// Precedes every block; the union keeps the data after it maximally aligned.
+  struct Owner
+  {
+    TreeArena *arena;
+    uint32_t   sizeClass;
+  };
+  union Header
+  {
+    Owner       owner;
+    long double alignment;
+  };
+  /// A free block, linked through its own storage.
+  struct FreeBlock
+  {
+    FreeBlock *next;
+  };
+
+  static TreeArena*& current() { static thread_local TreeArena *sCurrent = nullptr; return sCurrent; }
+  static uint32_t    sizeClass(size_t bytes);
+
+  Header* take(uint32_t sizeClass);
+  void    give(Header *header);
+
+  FreeBlock          *_free[ClassCount];
+  std::vector<void*>  _slabs;
+  uint8_t            *_cursor = nullptr;
+  uint8_t            *_slabEnd = nullptr;
+  size_t              _live = 0;
+};
+
+#pragma mark - TreeArena Implementation
+
+inline TreeArena::~TreeArena()
+{
+  assert(_live == 0 && "TreeArena destroyed while child lists still use it.");
+  reset();
+}
+
+inline bool TreeArena::reset()
+{
+  if (_live > 0)
+  {
+    TREENT_WARN("TreeArena: can't reset while " << _live << " blocks are in use.");
+    return false;
+  }
+
+  for (auto slab : _slabs)
+  {
+    ::operator delete(slab);
+  }
+  _slabs.clear();
+  for (auto &list : _free)
+  {
+    list = nullptr;
+  }
+  _cursor = _slabEnd = nullptr;
+  return true;
+}
+
+inline uint32_t TreeArena::sizeClass(size_t bytes)
+{
+  uint32_t c = 0;
+  while ((size_t(1) << (MinBlockShift + c)) < bytes)
+  {
+    c += 1;
+  }
+  return c;
+}
+
+inline void* TreeArena::allocate(size_t bytes)
+{
+  const auto total = bytes + sizeof(Header);
+  auto arena = current();
+  Header *header;
+  if (arena && total <= MaxBlockSize)
+  {
+    header = arena->take(sizeClass(total));
+  }
+  else
+  {
+    header = static_cast<Header*>(::operator new(total));
+    header->owner.arena = nullptr;
+  }
+  return header + 1;
+}
+
+inline void TreeArena::deallocate(void *data)
+{
+  auto header = static_cast<Header*>(data) - 1;
+  if (header->owner.arena)
+  {
+    header->owner.arena->give(header);
+  }
+  else
+  {
+    ::operator delete(header);
+  }
+}
+
+inline auto TreeArena::take(uint32_t c) -> Header*
+{
+  void *block = _free[c];
+  if (block)
+  {
+    _free[c] = _free[c]->next;
+  }
+  else
+  {
+    const auto size = size_t(1) << (MinBlockShift + c);
+    if (size_t(_slabEnd - _cursor) < size)
+    {
+      // Blocks are multiples of the smallest size, so they stay aligned as we bump
+      // through a slab. The tail a larger block didn't fit into goes unused.
+      _cursor = static_cast<uint8_t*>(::operator new(SlabSize));
+      _slabEnd = _cursor + SlabSize;
+      _slabs.push_back(_cursor);
+    }
+    block = _cursor;
+    _cursor += size;
+  }
+
+  auto header = static_cast<Header*>(block);
+  header->owner.arena = this;
+  header->owner.sizeClass = c;
+  _live += 1;
+  return header;
+}
+
+inline void TreeArena::give(Header *header)
+{
+  const auto c = header->owner.sizeClass;
+  auto block = reinterpret_cast<FreeBlock*>(header);
+  block->next = _free[c];
+  _free[c] = block;
+  _live -= 1;
+}
+
+} // namespace treent
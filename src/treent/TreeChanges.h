@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "entityx/Entity.h"
+#include "entityx/Event.h"
+#include "ChildrenComponent.h"
+#include "ParentComponent.h"
+#include "detail/ManagerRegistry.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace treent
+{
+
+///
+/// The net hierarchy change of one subtree since the last delivery, named by the subtree's root.
+///
+struct TreeChange
+{
+  enum class Kind
+  {
+    /// \a root, which was the root of its own tree, was linked under \a parent.
+    Attached,
+    /// \a root was moved from under \a previousParent to under \a parent, which may be the same node.
+    Moved,
+    /// \a root was unlinked from \a parent and is now the root of its own tree.
+    Detached,
+    /// \a root and its descendants were destroyed; \a parent is the node it was under, if any.
+    /// The handles are no longer valid, but their ids still identify what was cached.
+    Destroyed
+  };
+
+  Kind            kind;
+  entityx::Entity root;
+  entityx::Entity parent;
+  /// Where a Moved root was before; null for the other kinds.
+  entityx::Entity previousParent;
+};
+
+///
+/// The net hierarchy changes since the previous event, one per affected root, ordered by
+/// each root's last edit. The list is only valid while the event is being delivered.
+///
+struct TreeChangesEvent : public entityx::Event<TreeChangesEvent>
+{
+  explicit TreeChangesEvent(const std::vector<TreeChange> &changes)
+  : changes(changes)
+  {}
+
+  const std::vector<TreeChange> &changes;
+};
+
+///
+/// Collects the hierarchy changes of one EntityManager so they can be delivered as a single
+/// TreeChangesEvent per frame, instead of one event per node. An edit records one change
+/// for the root of the subtree it moved or destroyed, however many nodes that subtree holds;
+/// a bulk edit of thousands of nodes then costs consumers one dispatch.
+///
+/// flush() coalesces what was recorded into the net change of each root: a reparent is one
+/// Moved, attaching and then destroying a node is one Destroyed, attaching and then
+/// detaching it again is nothing, and changes to nodes that now sit inside an attached or
+/// moved subtree are left out, since consumers revisit that whole subtree anyway.
+///
+/// Recording is off until enabled, so worlds nobody listens to pay a single branch per edit.
+/// TreePropagationSystem flushes the log at the end of each update():
+///
+/// TreeChangeLog::instance(entities).setRecording(true);
+/// events.subscribe<TreeChangesEvent>(spatialIndex);
+///
+/// Edits that bypass TreentT, like destroying a tree entity directly, aren't recorded.
+///
+class TreeChangeLog
+{
+public:
+  /// The log of \a entities. Safe to call from any thread; each log is then used by one thread at a time.
+  static TreeChangeLog& instance(const entityx::EntityManager &entities);
+  /// Destroy the log of \a entities. Call when the manager goes away; see TreentT::release().
+  static void           release(const entityx::EntityManager &entities) { detail::ManagerRegistry<TreeChangeLog>::release(entities); }
+
+  void  setRecording(bool recording) { _recording = recording; if (! recording) { _changes.clear(); } }
+  bool  recording() const { return _recording; }
+
+  /// Appends a change if recording. Called by TreentT.
+  void  record(TreeChange::Kind kind, const entityx::Entity &root, const entityx::Entity &parent);
+
+  /// Changes recorded since the last flush(), edit by edit, before coalescing.
+  const std::vector<TreeChange>& changes() const { return _changes; }
+  /// Emits one TreeChangesEvent with the net changes, if there are any, and clears the log.
+  void  flush(entityx::EventManager &events);
+
+private:
+  TreeChangeLog() = default;
+  static TreeChangeLog* create(const entityx::EntityManager &) { return new TreeChangeLog; }
+
+  /// Where one root started out and its latest change.
+  struct NetChange
+  {
+    TreeChange      last;
+    entityx::Entity from;
+    size_t          position;
+  };
+
+  /// Reduce _changes to one net change per root in _delivering.
+  void  coalesce();
+
+  std::vector<TreeChange>               _changes;
+  /// Net changes being delivered, kept apart from _changes so receivers may make further edits.
+  std::vector<TreeChange>               _delivering;
+  /// Scratch space for coalesce(), kept to avoid reallocating each frame.
+  std::vector<NetChange>                _net;
+  std::unordered_map<uint64_t, size_t>  _netIndex;
+  std::unordered_set<uint64_t>          _linked;
+  bool                                  _recording = false;
+};
+
+#pragma mark - TreeChangeLog Implementation
+
+inline TreeChangeLog& TreeChangeLog::instance(const entityx::EntityManager &entities)
+{
+  return detail::ManagerRegistry<TreeChangeLog>::get(entities, &TreeChangeLog::create);
+}
+
+inline void TreeChangeLog::record(TreeChange::Kind kind, const entityx::Entity &root, const entityx::Entity &parent)
+{
+  if (_recording)
+  {
+    TreeChange change = { kind, root, parent, entityx::Entity() };
+    _changes.push_back(change);
+  }
+}
+
+inline void TreeChangeLog::flush(entityx::EventManager &events)
+{
+  if (_changes.empty())
+  {
+    return;
+  }
+
+  coalesce();
+  _changes.clear();
+  if (! _delivering.empty())
+  {
+    events.emit<TreeChangesEvent>(_delivering);
+  }
+  _delivering.clear();
+}
+
+inline void TreeChangeLog::coalesce()
+{
+  using Kind = TreeChange::Kind;
+  _net.clear();
+  _netIndex.clear();
+  _linked.clear();
+
+  for (size_t i = 0; i < _changes.size(); ++i)
+  {
+    const auto &change = _changes[i];
+    auto found = _netIndex.insert(std::make_pair(change.root.id().id(), _net.size()));
+    if (found.second)
+    {
+      // Linking always unlinks first, so a root that starts with Attached started out alone.
+      NetChange net = { change, change.kind == Kind::Attached ? entityx::Entity() : change.parent, i };
+      _net.push_back(net);
+    }
+    auto &net = _net[found.first->second];
+    net.last = change;
+    net.position = i;
+  }
+  std::sort(_net.begin(), _net.end(), [] (const NetChange &a, const NetChange &b) { return a.position < b.position; });
+
+  for (auto &net : _net)
+  {
+    auto change = net.last;
+    switch (change.kind)
+    {
+      case Kind::Attached:
+      case Kind::Moved:
+        if (! change.root.valid())
+        {
+          // Destroyed along with a subtree it was linked into.
+          change.kind = Kind::Destroyed;
+          change.parent = net.from;
+        }
+        else if (net.from)
+        {
+          change.kind = Kind::Moved;
+          change.previousParent = net.from;
+          _linked.insert(change.root.id().id());
+        }
+        else
+        {
+          _linked.insert(change.root.id().id());
+        }
+        break;
+      case Kind::Detached:
+        // Linked and unlinked again leaves it as it was.
+        if (! net.from)
+        {
+          continue;
+        }
+        change.parent = net.from;
+        break;
+      case Kind::Destroyed:
+        change.parent = net.from;
+        break;
+    }
+    _delivering.push_back(change);
+  }
+
+  if (_linked.size() < 2)
+  {
+    return;
+  }
+  // Drop links of nodes whose ancestors were linked too; the outer change covers them.
+  auto covered = [this] (const TreeChange &change)
+  {
+    if (change.kind != TreeChange::Kind::Attached && change.kind != TreeChange::Kind::Moved)
+    {
+      return false;
+    }
+    auto node = change.root;
+    for (auto pc = node.component<ParentComponent>(); pc; pc = node.component<ParentComponent>())
+    {
+      node = pc->_parent.entity(*node.component<ChildrenComponent>()->entities());
+      if (_linked.count(node.id().id()))
+      {
+        return true;
+      }
+    }
+    return false;
+  };
+  _delivering.erase(std::remove_if(_delivering.begin(), _delivering.end(), covered), _delivering.end());
+}
+
+} // namespace treent
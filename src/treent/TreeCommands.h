@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Treent.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace treent
+{
+
+///
+/// Records tree edits from any thread and applies them later on the thread that owns
+/// the EntityManager.
+///
+/// Tree mutation touches child lists shared between entities, so it can't happen on
+/// worker threads directly. Instead, workers record commands here without taking a lock.
+/// apply() then plays every command back in the order it was recorded. Runs of consecutive
+/// destroys are batched into a single pass, which runs before the next other command.
+///
+/// Commands are kept in chunks owned by the buffer and reused after each apply(), along with
+/// setup functions small enough to fit beside them, so recording doesn't allocate once warm.
+///
+/// Children created through a command buffer don't exist until apply(). Pass a setup
+/// function to configure them; it runs on the applying thread.
+///
+/// TreeCommandBufferT<Your,Tree,Components> commands(entities);
+/// jobs.spawn([&] { commands.createChild(parent, [] (Treent &child) { ... }); });
+/// jobs.wait();
+/// commands.apply();
+///
+template <typename ... TreeComponents>
+class TreeCommandBufferT
+{
+public:
+  using Treent = TreentT<TreeComponents...>;
+
+  /// Commands per chunk of storage.
+  static const size_t ChunkSize = 128;
+  /// Setup functions up to this size are stored beside their command; larger ones go to the heap.
+  static const size_t SetupSize = 48;
+
+  explicit TreeCommandBufferT(EntityManager &entities);
+  ~TreeCommandBufferT();
+
+  TreeCommandBufferT(const TreeCommandBufferT&) = delete;
+  TreeCommandBufferT& operator=(const TreeCommandBufferT&) = delete;
+
+  //
+  // Recording. Safe to call from any number of threads at once.
+  //
+
+  /// Create a child of \a parent.
+  void createChild(const Entity &parent) { record(Operation::CreateChild, parent, Entity()); }
+  /// Create a child of \a parent, then pass it to \a setup: any callable taking a Treent&.
+  template <typename F>
+  void createChild(const Entity &parent, F &&setup);
+  /// Move \a child, along with its subtree, to the end of \a parent's children.
+  void appendChild(const Entity &parent, const Entity &child) { record(Operation::AppendChild, parent, child); }
+  /// Detach \a child from its parent, making it a root.
+  void detachFromParent(const Entity &child) { record(Operation::DetachFromParent, child, Entity()); }
+  /// Destroy \a root and all of its descendants.
+  void destroySubtree(const Entity &root) { record(Operation::DestroySubtree, root, Entity()); }
+  /// Destroy all descendants of \a parent.
+  void destroyChildren(const Entity &parent) { record(Operation::DestroyChildren, parent, Entity()); }
+
+  //
+  // Playback. Call from the thread that owns the EntityManager while nothing is recording.
+  //
+
+  /// Apply every recorded command and clear the buffer. Returns the number of commands applied.
+  /// Commands that refer to entities destroyed in the meantime are skipped.
+  size_t apply();
+  /// Drop every recorded command without applying it.
+  void   discard();
+  bool   empty() const;
+
+private:
+  enum class Operation : uint8_t
+  {
+    CreateChild,
+    AppendChild,
+    DetachFromParent,
+    DestroySubtree,
+    DestroyChildren
+  };
+
+  struct Command
+  {
+    Operation  operation;
+    Entity     target;
+    Entity     other;
+    /// Runs the setup function held in storage on \a child, if given, then destroys it. Null when there is none.
+    void     (*setup)(void *storage, Treent *child);
+    typename std::aligned_storage<SetupSize>::type storage;
+  };
+
+  ///
+  /// A block of commands. The buffer's chunks form a chain; recording fills the chunk at
+  /// the end, moving on to the next spare one or a new one when it is full.
+  ///
+  struct Chunk
+  {
+    /// Slots handed out; may run past ChunkSize while threads race to move on.
+    std::atomic<size_t> reserved { 0 };
+    Chunk              *previous = nullptr;
+    /// The spare chunk to move on to. Only changed by apply() and discard().
+    Chunk              *next = nullptr;
+    Command             commands[ChunkSize];
+  };
+
+  template <typename F>
+  static void runSetup(void *storage, Treent *child);
+  template <typename F>
+  static void runHeapSetup(void *storage, Treent *child);
+  template <typename F>
+  static void storeSetup(Command &command, F &&setup, std::true_type fits);
+  template <typename F>
+  static void storeSetup(Command &command, F &&setup, std::false_type fits);
+
+  /// Claims the next slot in recording order, without locking.
+  Command& reserve();
+  void     record(Operation operation, const Entity &target, const Entity &other);
+  /// Calls \a fn on every recorded command in order, then readies every chunk for reuse.
+  template <typename F>
+  void     drain(F &&fn);
+  void     flushDestroyed();
+
+  EntityManager          &_entities;
+  Chunk                  *_first;
+  std::atomic<Chunk*>     _current;
+  std::vector<Entity>     _destroyed;
+};
+
+#pragma mark - TreeCommandBuffer Template Implementation
+
+template <typename ... TreeComponents>
+TreeCommandBufferT<TreeComponents...>::TreeCommandBufferT(EntityManager &entities)
+: _entities(entities),
+  _first(new Chunk),
+  _current(_first)
+{}
+
+template <typename ... TreeComponents>
+TreeCommandBufferT<TreeComponents...>::~TreeCommandBufferT()
+{
+  discard();
+  for (auto chunk = _first; chunk; )
+  {
+    auto next = chunk->next;
+    delete chunk;
+    chunk = next;
+  }
+}
+
+template <typename ... TreeComponents>
+auto TreeCommandBufferT<TreeComponents...>::reserve() -> Command&
+{
+  for (;;)
+  {
+    auto chunk = _current.load(std::memory_order_acquire);
+    const auto index = chunk->reserved.fetch_add(1, std::memory_order_relaxed);
+    if (index < ChunkSize)
+    {
+      return chunk->commands[index];
+    }
+
+    // Full: move on to the spare chunk after it, or a new one. Losers of the race retry.
+    auto next = chunk->next;
+    const bool fresh = ! next;
+    if (fresh)
+    {
+      next = new Chunk;
+      next->previous = chunk;
+    }
+    if (! _current.compare_exchange_strong(chunk, next, std::memory_order_acq_rel) && fresh)
+    {
+      delete next;
+    }
+  }
+}
+
+template <typename ... TreeComponents>
+void TreeCommandBufferT<TreeComponents...>::record(Operation operation, const Entity &target, const Entity &other)
+{
+  auto &command = reserve();
+  command.operation = operation;
+  command.target = target;
+  command.other = other;
+  command.setup = nullptr;
+}
+
+template <typename ... TreeComponents>
+template <typename F>
+void TreeCommandBufferT<TreeComponents...>::createChild(const Entity &parent, F &&setup)
+{
+  using Setup = typename std::decay<F>::type;
+  auto &command = reserve();
+  command.operation = Operation::CreateChild;
+  command.target = parent;
+  command.other = Entity();
+  storeSetup(command, std::forward<F>(setup), std::integral_constant<bool, sizeof(Setup) <= SetupSize && std::alignment_of<Setup>::value <= std::alignment_of<decltype(command.storage)>::value>());
+}
+
+template <typename ... TreeComponents>
+template <typename F>
+void TreeCommandBufferT<TreeComponents...>::storeSetup(Command &command, F &&setup, std::true_type)
+{
+  using Setup = typename std::decay<F>::type;
+  new (&command.storage) Setup(std::forward<F>(setup));
+  command.setup = &runSetup<Setup>;
+}
+
+template <typename ... TreeComponents>
+template <typename F>
+void TreeCommandBufferT<TreeComponents...>::storeSetup(Command &command, F &&setup, std::false_type)
+{
+  using Setup = typename std::decay<F>::type;
+  new (&command.storage) Setup*(new Setup(std::forward<F>(setup)));
+  command.setup = &runHeapSetup<Setup>;
+}
+
+template <typename ... TreeComponents>
+template <typename F>
+void TreeCommandBufferT<TreeComponents...>::runSetup(void *storage, Treent *child)
+{
+  auto &setup = *static_cast<F*>(storage);
+  if (child)
+  {
+    setup(*child);
+  }
+  setup.~F();
+}
+
+template <typename ... TreeComponents>
+template <typename F>
+void TreeCommandBufferT<TreeComponents...>::runHeapSetup(void *storage, Treent *child)
+{
+  auto setup = *static_cast<F**>(storage);
+  if (child)
+  {
+    (*setup)(*child);
+  }
+  delete setup;
+}
+
+template <typename ... TreeComponents>
+template <typename F>
+void TreeCommandBufferT<TreeComponents...>::drain(F &&fn)
+{
+  // Recording only ever appends to the chain, so walk back from where it stopped.
+  auto last = _current.load(std::memory_order_acquire);
+  for (auto chunk = last; chunk->previous; chunk = chunk->previous)
+  {
+    chunk->previous->next = chunk;
+  }
+
+  for (auto chunk = _first; chunk; chunk = chunk->next)
+  {
+    const auto count = std::min<size_t>(chunk->reserved.load(std::memory_order_relaxed), ChunkSize);
+    for (size_t i = 0; i < count; ++i)
+    {
+      auto &command = chunk->commands[i];
+      fn(command);
+      command.target = Entity();
+      command.other = Entity();
+    }
+    chunk->reserved.store(0, std::memory_order_relaxed);
+    if (chunk == last)
+    {
+      // Chunks after this one are spares that went unused.
+      break;
+    }
+  }
+  _current.store(_first, std::memory_order_release);
+}
+
+template <typename ... TreeComponents>
+void TreeCommandBufferT<TreeComponents...>::flushDestroyed()
+{
+  if (! _destroyed.empty())
+  {
+    Treent::destroySubtrees(_destroyed);
+    _destroyed.clear();
+  }
+}
+
+template <typename ... TreeComponents>
+size_t TreeCommandBufferT<TreeComponents...>::apply()
+{
+  size_t count = 0;
+  drain([this, &count] (Command &command)
+  {
+    count += 1;
+    auto &target = command.target;
+    const bool destroys = command.operation == Operation::DestroySubtree || command.operation == Operation::DestroyChildren;
+    if (! destroys)
+    {
+      // Later commands see the world as it was after the destroys recorded before them.
+      flushDestroyed();
+    }
+
+    if (! target.valid())
+    {
+      if (command.setup)
+      {
+        command.setup(&command.storage, nullptr);
+      }
+      return;
+    }
+
+    switch (command.operation)
+    {
+      case Operation::CreateChild:
+      {
+        auto child = Treent(_entities, target).createChild();
+        if (command.setup)
+        {
+          command.setup(&command.storage, &child);
+        }
+        break;
+      }
+      case Operation::AppendChild:
+        if (command.other.valid() && command.other != target)
+        {
+          Treent(_entities, target).appendChild(command.other);
+        }
+        break;
+      case Operation::DetachFromParent:
+        Treent::detachFromParent(target);
+        break;
+      case Operation::DestroySubtree:
+        _destroyed.push_back(target);
+        break;
+      case Operation::DestroyChildren:
+        for (auto child : Treent(_entities, target).getChildren())
+        {
+          _destroyed.push_back(child);
+        }
+        break;
+    }
+  });
+  flushDestroyed();
+  return count;
+}
+
+template <typename ... TreeComponents>
+void TreeCommandBufferT<TreeComponents...>::discard()
+{
+  drain([] (Command &command)
+  {
+    if (command.setup)
+    {
+      command.setup(&command.storage, nullptr);
+    }
+  });
+}
+
+template <typename ... TreeComponents>
+bool TreeCommandBufferT<TreeComponents...>::empty() const
+{
+  auto chunk = _current.load(std::memory_order_acquire);
+  return chunk == _first && chunk->reserved.load(std::memory_order_relaxed) == 0;
+}
+
+} // namespace treent
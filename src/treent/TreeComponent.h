@@ -2,17 +2,51 @@
 #pragma once
 
 #include "entityx/Entity.h"
+#include "TreeOrder.h"
+#include "TreeLinks.h"
+#include "detail/TraversalStack.h"
+#include <type_traits>
 
 namespace treent
 {
 
+/// How TreeComponent::worldValue() finds a component's current world value.
+enum class Evaluation
+{
+  /// Read the value stored by the last descend pass, composing down from the nearest clean ancestor when stale.
+  Eager,
+  /// Resolve on read and keep the result in the component until something on the path to the root changes.
+  Lazy
+};
+
+namespace detail
+{
+
+/// Memoized world value of a lazily evaluated component. Eager components store nothing.
+template <typename World, Evaluation E>
+struct WorldMemo
+{};
+
+template <typename World>
+struct WorldMemo<World, Evaluation::Lazy>
+{
+  mutable World _memo;
+  mutable bool  _memoValid = false;
+};
+
+} // namespace detail
+
 ///
 /// A component that can be part of a single-parent, multiple-child tree structure.
-/// Derived types must define a `compose` method, which is called during traversal to
-/// compose either the parent or the child into the current component.
-/// `compose(const Derived &)`
-/// It generally only makes sense to traverse the tree in one direction, so both ascend()
-/// and descend() use the same compose() method, albeit passing different parameters.
+/// Each component stores a Local value, relative to its parent, and a World value
+/// composed from its parent's world value and its own local value.
+/// Derived types provide the composition as a static method:
+/// `static World compose(const World &parentWorld, const Local &local)`
+/// A default-constructed World is the identity; roots have World() as their parent value.
+///
+/// Since compose() only ever reads local values and writes world values, composition can
+/// be re-run at any time without corrupting data. World values are not stored in the
+/// component itself, but in a dense array owned by the TreeOrder of the component type.
 ///
 /// Note that the relationship between TreeComponents is not automatically cleaned up when
 /// a component is destroyed. Automatically cleaning up would cause a cascade of unnecessary
@@ -24,21 +58,59 @@ namespace treent
 ///
 /// The above is only necessary if you might destroy a child before its parent.
 ///
-template <typename Derived>
-struct TreeComponent : public entityx::Component<Derived>
+/// To compose every tree of a component type at once, use descendAll(), which walks a
+/// flattened TreeOrder instead of recursing through component handles.
+///
+/// Components track whether they need to be recomposed. Changing the local value through
+/// setLocal() or editLocal() marks the component dirty, as do attaching and detaching.
+/// descendDirty() then recomposes only the dirty subtrees and skips clean branches.
+///
+/// LinksT selects how children are stored (see TreeLinks.h). The default VectorLinks keeps
+/// handles in a small vector; SiblingLinks makes attach, detach and reparent O(1) for nodes
+/// with many children:
+///
+/// struct ItemComponent : TreeComponent<ItemComponent, Transform, Transform, SiblingLinks>
+///
+/// EvaluationT picks how worldValue() is answered. Eager components expect a descend pass
+/// each frame and read its results. When only a few components are read per frame, Lazy
+/// components skip the passes instead: worldValue() composes down from the nearest ancestor
+/// with a remembered value and remembers the result for every node on the way. markDirty()
+/// forgets the remembered values of the subtree, visiting only the nodes that had one, so a
+/// frame costs time in proportion to what was read rather than to the size of the forest.
+/// Lazy components can still be composed by descend passes, for world() and TreeSpan.
+///
+/// struct BoneComponent : TreeComponent<BoneComponent, Affine3d, Affine3d, VectorLinks, Evaluation::Lazy>
+///
+template <typename Derived, typename LocalT, typename WorldT = LocalT, template <typename> class LinksT = VectorLinks, Evaluation EvaluationT = Evaluation::Eager>
+struct TreeComponent : public entityx::Component<Derived>, private detail::WorldMemo<WorldT, EvaluationT>
 {
 public:
+  using Local = LocalT;
+  using World = WorldT;
+  using Links = LinksT<Derived>;
+
+  TreeComponent() = default;
+  explicit TreeComponent(const Local &local)
+  : _local(local)
+  {}
+
   /// Cast to derived type.
-  Derived& self() { return static_cast<Derived&>(*this); }
+  Derived&       self() { return static_cast<Derived&>(*this); }
+  const Derived& self() const { return static_cast<const Derived&>(*this); }
 
 	/// Remove self from parent on destruction.
 	/// Also tell children we are no longer their parent.
 	virtual ~TreeComponent()
 	{
-		for( auto &child : _children ) {
-			child->_parent = Ref();
+		_links.each([] (Derived &child) { child._parent = Ref(); child.markDirty(); child.updateIndex(); });
+		_links.clear();
+		// Detach without marking ourselves dirty; nobody should hear about a dying component.
+		if (_parent.valid())
+		{
+			_parent->removeChild(&self());
 		}
-		detachFromParent();
+		leaveIndex();
+		invalidateOrder();
 	}
 
   using Ref = entityx::ComponentHandle<Derived>;
@@ -50,89 +122,395 @@ public:
   void removeChild(Derived *child);
   void removeChildren();
   void detachFromParent();
+  /// Forget all children without marking them dirty or invalidating the TreeOrder.
+  /// Only safe when the children are about to be destroyed; see TreentT::destroySubtree().
+  void releaseChildren();
 
-  /// Visit all children depth-first.
-  /// Passes parent to each child's compose(const Derived &) method.
+  /// Visit all children depth-first, composing each child's world value from its parent's.
+  /// Roots refresh their own world value first.
+  /// Iterative, so arbitrarily deep trees don't exhaust the call stack.
   void descend();
-  /// Visit all parents (depth-only).
-  /// Passes each child to parent's compose(const Derived &) method.
+  /// Bring our world value up to date without composing the rest of the tree.
+  /// Composes from the nearest ancestor with a current world value, like worldValue(),
+  /// and stores only our own value; ancestors are left untouched.
   void ascend();
+  /// Roots of every tree of Derived components in \a entities, without scanning them.
+  /// Lone components, with neither parent nor children, are not listed.
+  static const std::vector<Derived*>& roots(const entityx::EntityManager &entities) { return TreeOrder<Derived>::instance(entities).roots(); }
+  /// Compose every tree of Derived components in \a entities, parents before children.
+  /// Same result as calling descend() on each root, in one linear pass.
+  static void descendAll(entityx::EntityManager &entities) { TreeOrder<Derived>::instance(entities).descendAll(entities); }
+  /// Compose only the subtrees of Derived components in \a entities that were marked dirty.
+  /// See TreeOrder::composedCount() for the number of components recomposed.
+  static void descendDirty(entityx::EntityManager &entities) { TreeOrder<Derived>::instance(entities).descendDirty(entities); }
+  /// Parallel versions of descendAll() and descendDirty(). Subtrees smaller than \a grainSize are not forked.
+  static void descendAll(entityx::EntityManager &entities, TaskPool &pool, size_t grainSize = TreeOrder<Derived>::DefaultGrainSize) { TreeOrder<Derived>::instance(entities).descendAll(entities, pool, grainSize); }
+  static void descendDirty(entityx::EntityManager &entities, TaskPool &pool, size_t grainSize = TreeOrder<Derived>::DefaultGrainSize) { TreeOrder<Derived>::instance(entities).descendDirty(entities, pool, grainSize); }
+
+  /// Compose every tree level by level with SIMD kernels. Requires a BatchCompose<Derived> specialization.
+  static void descendLevels(entityx::EntityManager &entities) { TreeOrder<Derived>::instance(entities).descendLevels(entities); }
 
-  /// Convenience method for
-  void compose(const Ref &handle) { compose(*handle.get()); }
+  /// Flag this component (and with it, its subtree) for recomposition.
+  /// Ancestors are flagged as having dirty descendants so the next pass can find us.
+  void markDirty();
+  bool isDirty() const { return _dirty; }
+
+  /// Value relative to our parent.
+  const Local&  local() const { return _local; }
+  /// Replace the local value and mark this component dirty.
+  void          setLocal(const Local &local) { _local = local; markDirty(); }
+  /// Mark this component dirty and return its local value for modification.
+  Local&        editLocal() { markDirty(); return _local; }
+
+  /// Value in the space of our root, as of the most recent composition.
+  /// Components that have never been composed return their local value composed with World().
+  World         world() const { return order().world(self()); }
+  /// Current value in the space of our root, even if we or our ancestors are dirty.
+  /// Eager: looks up our stored world value when the order is clean, otherwise climbs to the
+  /// nearest clean ancestor and composes down from there. Writes nothing, so it is safe
+  /// to call from many threads at once while the trees aren't being edited or composed.
+  /// Lazy: climbs to the nearest ancestor with a remembered value and remembers every value
+  /// composed on the way down. Not safe to call from several threads at once.
+  World         worldValue() const { return worldValue(IsLazy()); }
+
+  /// The order holding our world value: that of our EntityManager once bound.
+  TreeOrder<Derived>& order() const { return _order ? *_order : TreeOrder<Derived>::instance(); }
+  /// Bind this component, which belongs to the entity \a id, to \a order.
+  /// TreentT binds its components to their manager's order.
+  void          setOrder(TreeOrder<Derived> &order, entityx::Entity::Id id);
+  bool          hasOrder() const { return _order != nullptr; }
 
   bool isRoot() { return ! _parent; }
-  bool isLeaf() { return _children.empty(); }
+  bool isLeaf() { return _links.empty(); }
+
+  size_t childCount() const { return _links.size(); }
+  /// Make room for \a count children without reallocating. No-op for linkage policies without storage.
+  void reserveChildren(size_t count) { _links.reserve(count); }
+  /// Release unused child list capacity.
+  void shrinkChildren() { _links.shrink(); }
 
   Ref getParent() { return _parent; }
+  /// Id of the entity we belong to, known once we have been bound or linked to a parent or child.
+  /// Lets TreeView find an ordered node's entity without a search.
+  entityx::Entity::Id entityId() const { return _id; }
 private:
+  friend class TreeOrder<Derived>;
+  friend class LinksT<Derived>;
+
+  using IsLazy = std::integral_constant<bool, EvaluationT == Evaluation::Lazy>;
+  World worldValue(std::false_type) const;
+  World worldValue(std::true_type) const;
+  /// Forget the remembered world values of our subtree. Nothing to forget when eager.
+  void  forgetWorld(std::false_type) {}
+  void  forgetWorld(std::true_type);
+
+  /// Flag our order for a rebuild, or every order if we are not bound to one yet.
+  void invalidateOrder() { if (_order) { _order->invalidate(); } else { TreeOrder<Derived>::invalidateAll(); } }
+  /// Keep our entries in our order's indices current: the root index while we head a
+  /// tree, the lone index while we are bound with neither parent nor children.
+  void updateIndex();
+  /// Leave both indices, as we are being destroyed.
+  void leaveIndex();
+  /// Switch to \a order, carrying our root index entry along.
+  void moveToOrder(TreeOrder<Derived> *order);
+
   Ref               _parent;
-  std::vector<Ref>  _children;
+  Links             _links;
+  entityx::Entity::Id _id;
+  TreeOrder<Derived> *_order = nullptr;
+  Local             _local;
+  /// Location of our world value in the TreeOrder, valid while _generation matches.
+  uint32_t          _slot = TreeOrder<Derived>::npos;
+  uint32_t          _generation = 0;
+  /// Our position in the order's root index, or npos when we aren't the root of a tree.
+  uint32_t          _rootIndex = TreeOrder<Derived>::npos;
+  /// Our position in the order's lone index, or npos when we aren't a lone node.
+  uint32_t          _loneIndex = TreeOrder<Derived>::npos;
+  bool              _dirty = true;
+  bool              _dirtyDescendants = false;
 };
 
 #pragma mark - TreeComponent Template Implementation
 
-template <typename D>
-void TreeComponent<D>::attachToParent(Ref child, Ref parent)
+template <typename D, typename L, typename W, template <typename> class K, Evaluation E>
+void TreeComponent<D, L, W, K, E>::attachToParent(Ref child, Ref parent)
 {
+  // Unbound nodes join the order of the node they are linked to.
+  if (! child->_order)
+  {
+    child->moveToOrder(parent->_order);
+  }
+  else if (! parent->_order)
+  {
+    parent->moveToOrder(child->_order);
+  }
+  assert(child->_order == parent->_order && "Parent and child belong to different entity managers.");
+
   child->_parent = parent;
-  parent->_children.push_back(child);
+  child->_id = child.entity().id();
+  parent->_id = parent.entity().id();
+  parent->_links.append(*child.get(), child);
+  child->updateIndex();
+  parent->updateIndex();
+  child->markDirty();
+  child->invalidateOrder();
+  TREENT_STAT_ADD(attached, 1);
 }
 
-template <typename D>
-void TreeComponent<D>::removeChild(D *child)
+template <typename D, typename L, typename W, template <typename> class K, Evaluation E>
+void TreeComponent<D, L, W, K, E>::markDirty()
+{
+  _dirty = true;
+  order().markDirty();
+  order().notifyDirty(self());
+  forgetWorld(IsLazy());
+
+  auto parent = _parent;
+  while (parent && ! parent->_dirtyDescendants)
+  {
+    parent->_dirtyDescendants = true;
+    parent = parent->_parent;
+  }
+}
+
+template <typename D, typename L, typename W, template <typename> class K, Evaluation E>
+void TreeComponent<D, L, W, K, E>::removeChild(D *child)
 {
   assert(child->_parent.get() == &self());
   child->_parent = Ref(); // make invalid
+  _links.remove(*child);
+  child->updateIndex();
+  updateIndex();
+  invalidateOrder();
+  TREENT_STAT_ADD(detached, 1);
+}
 
-  auto comp = [child] (Ref &b)
+template <typename D, typename L, typename W, template <typename> class K, Evaluation E>
+void TreeComponent<D, L, W, K, E>::removeChildren()
+{
+  // Clear parents first; detaching one at a time would modify the links mid-iteration.
+  _links.each([] (D &child)
   {
-		if( b.valid() ) {
-			return b.get() == child;
-		}
-		return true;
-  };
+    child._parent = Ref();
+    child.markDirty();
+    child.updateIndex();
+  });
+  TREENT_STAT_ADD(detached, _links.size());
+  _links.clear();
+  updateIndex();
+  invalidateOrder();
+}
+
+template <typename D, typename L, typename W, template <typename> class K, Evaluation E>
+void TreeComponent<D, L, W, K, E>::setOrder(TreeOrder<D> &order, entityx::Entity::Id id)
+{
+  _id = id;
+  if (_order != &order)
+  {
+    invalidateOrder();
+    moveToOrder(&order);
+    _order->invalidate();
+  }
+}
+
+template <typename D, typename L, typename W, template <typename> class K, Evaluation E>
+void TreeComponent<D, L, W, K, E>::moveToOrder(TreeOrder<D> *order)
+{
+  leaveIndex();
+  _order = order;
+  updateIndex();
+  // Our world value stays behind in the old order.
+  markDirty();
+}
+
+template <typename D, typename L, typename W, template <typename> class K, Evaluation E>
+void TreeComponent<D, L, W, K, E>::updateIndex()
+{
+  const bool heads = ! _parent && ! _links.empty();
+  const bool indexed = _rootIndex != TreeOrder<D>::npos;
+  if (heads && ! indexed)
+  {
+    order().addRoot(self());
+  }
+  else if (! heads && indexed)
+  {
+    order().removeRoot(self());
+  }
 
-  _children.erase(std::remove_if(_children.begin(), _children.end(), comp), _children.end());
+  // Unbound lone nodes can't say which manager they belong to, so they aren't listed.
+  const bool alone = _order && ! _parent && _links.empty();
+  const bool listed = _loneIndex != TreeOrder<D>::npos;
+  if (alone && ! listed)
+  {
+    _order->addLone(self());
+  }
+  else if (! alone && listed)
+  {
+    _order->removeLone(self());
+  }
 }
 
-template <typename D>
-void TreeComponent<D>::removeChildren()
+template <typename D, typename L, typename W, template <typename> class K, Evaluation E>
+void TreeComponent<D, L, W, K, E>::leaveIndex()
 {
-  for (auto child : _children)
+  if (_rootIndex != TreeOrder<D>::npos)
+  {
+    order().removeRoot(self());
+  }
+  if (_loneIndex != TreeOrder<D>::npos)
   {
-    child->detachFromParent();
+    _order->removeLone(self());
   }
-  _children.clear();
 }
 
-template <typename D>
-void TreeComponent<D>::detachFromParent()
+template <typename D, typename L, typename W, template <typename> class K, Evaluation E>
+void TreeComponent<D, L, W, K, E>::releaseChildren()
+{
+  // The children are about to go, so they don't join the root index.
+  _links.each([] (D &child) { child._parent = Ref(); });
+  _links.clear();
+  updateIndex();
+}
+
+template <typename D, typename L, typename W, template <typename> class K, Evaluation E>
+void TreeComponent<D, L, W, K, E>::detachFromParent()
 {
   if (_parent.valid())
   {
     _parent->removeChild(&self());
     _parent = Ref();
+    markDirty();
   }
 }
 
-template <typename D>
-void TreeComponent<D>::descend()
+template <typename D, typename L, typename W, template <typename> class K, Evaluation E>
+void TreeComponent<D, L, W, K, E>::descend()
 {
-  for (auto &c : _children)
+  TREENT_STAT_TIMER(propagationNanoseconds);
+  auto &order = this->order();
+  size_t count = 0;
+  if (isRoot())
   {
-    c->compose(self());
-    c->descend();
+    order.setWorld(self(), D::compose(W(), _local));
+    _dirty = false;
+    count += 1;
   }
+
+  _dirtyDescendants = false;
+
+  detail::TraversalStack<D*> stack;
+  stack.push(&self());
+  while (! stack.empty())
+  {
+    auto node = stack.pop();
+    const auto world = order.world(*node);
+    node->_links.each([&] (D &child)
+    {
+      order.setWorld(child, D::compose(world, child._local));
+      child._dirty = false;
+      child._dirtyDescendants = false;
+      stack.push(&child);
+    });
+    count += node->_links.size();
+  }
+  TREENT_STAT_ADD(composed, count);
 }
 
-template <typename D>
-void TreeComponent<D>::ascend()
+template <typename D, typename L, typename W, template <typename> class K, Evaluation E>
+void TreeComponent<D, L, W, K, E>::ascend()
 {
-  if (_parent)
+  order().setWorld(self(), worldValue());
+  TREENT_STAT_ADD(composed, 1);
+}
+
+template <typename D, typename L, typename W, template <typename> class K, Evaluation E>
+auto TreeComponent<D, L, W, K, E>::worldValue(std::false_type) const -> W
+{
+  const auto &order = this->order();
+  if (order.clean() && order.hasSlot(self()))
+  {
+    return order.world(self());
+  }
+
+  // Everything above the topmost stale node has a current world value.
+  const D *stale = nullptr;
+  for (auto node = &self(); node; node = node->_parent ? node->_parent.get() : nullptr)
+  {
+    if (node->_dirty || ! order.hasSlot(*node))
+    {
+      stale = node;
+    }
+  }
+  if (! stale)
+  {
+    return order.world(self());
+  }
+
+  detail::TraversalStack<const D*> stack;
+  for (auto node = &self(); node != stale; node = node->_parent.get())
+  {
+    stack.push(node);
+  }
+
+  auto world = stale->_parent ? order.world(*stale->_parent.get()) : W();
+  world = D::compose(world, stale->_local);
+  while (! stack.empty())
+  {
+    world = D::compose(world, stack.pop()->_local);
+  }
+  return world;
+}
+
+template <typename D, typename L, typename W, template <typename> class K, Evaluation E>
+auto TreeComponent<D, L, W, K, E>::worldValue(std::true_type) const -> W
+{
+  if (this->_memoValid)
+  {
+    return this->_memo;
+  }
+
+  // A remembered value implies remembered values all the way up, so stop at the first one.
+  detail::TraversalStack<const D*> stack;
+  auto node = &self();
+  while (node && ! node->_memoValid)
+  {
+    stack.push(node);
+    node = node->_parent ? node->_parent.get() : nullptr;
+  }
+
+  auto world = node ? node->_memo : W();
+  while (! stack.empty())
+  {
+    auto next = stack.pop();
+    world = D::compose(world, next->_local);
+    next->_memo = world;
+    next->_memoValid = true;
+  }
+  return world;
+}
+
+template <typename D, typename L, typename W, template <typename> class K, Evaluation E>
+void TreeComponent<D, L, W, K, E>::forgetWorld(std::true_type)
+{
+  // Nodes below one without a remembered value have none either.
+  if (! this->_memoValid)
+  {
+    return;
+  }
+
+  detail::TraversalStack<D*> stack;
+  stack.push(&self());
+  while (! stack.empty())
   {
-    _parent->compose(self());
-    _parent->ascend();
+    auto node = stack.pop();
+    node->_memoValid = false;
+    node->_links.each([&stack] (D &child)
+    {
+      if (child._memoValid)
+      {
+        stack.push(&child);
+      }
+    });
   }
 }
 
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "entityx/Entity.h"
+#include "ChildrenComponent.h"
+#include "TreeStats.h"
+#include "detail/SmallVector.h"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+namespace treent
+{
+
+///
+/// Child linkage policies for TreeComponent.
+/// Each policy stores a node's children and exposes the same small interface:
+///
+/// append(Node &child, const Ref &handle), remove(Node &child), clear(),
+/// each(fn), eachReversed(fn), size(), empty(), reserve(n), shrink()
+///
+/// Callbacks passed to each() and eachReversed() receive a Node& and must not change
+/// the links they are iterating over.
+///
+
+///
+/// Stores children as component pointers in a small-buffer vector.
+/// Iteration is a linear scan over contiguous memory; removing a child is O(children),
+/// except for the last one, which is found first.
+/// Like SiblingLinks, relies on children unlinking themselves before their components go away,
+/// so the pointers need no validity check and take half the room of component handles.
+/// The default, and the right choice for nodes with a handful of children.
+///
+template <typename Node>
+class VectorLinks
+{
+public:
+  using Ref = entityx::ComponentHandle<Node>;
+
+  void    append(Node &child, const Ref &handle);
+  void    remove(Node &child);
+  void    clear() { _children.clear(); }
+
+  template <typename F>
+  void    each(F &&fn) const;
+  template <typename F>
+  void    eachReversed(F &&fn) const;
+
+  size_t  size() const { return _children.size(); }
+  bool    empty() const { return _children.empty(); }
+  void    reserve(size_t count) { _children.reserve(count); }
+  void    shrink() { _children.shrink_to_fit(); }
+
+private:
+  detail::SmallVector<Node*, TREENT_INLINE_CHILDREN> _children;
+};
+
+///
+/// Links children intrusively through first-child, last-child, next- and previous-sibling
+/// pointers, so attaching, detaching and reparenting are O(1) regardless of how many
+/// siblings a node has. Use for list-like nodes with thousands of children that change often.
+/// Iterating follows pointers from one component to the next instead of scanning an array.
+///
+template <typename Node>
+class SiblingLinks
+{
+public:
+  using Ref = entityx::ComponentHandle<Node>;
+
+  void    append(Node &child, const Ref &handle);
+  void    remove(Node &child);
+  void    clear();
+
+  template <typename F>
+  void    each(F &&fn) const;
+  template <typename F>
+  void    eachReversed(F &&fn) const;
+
+  size_t  size() const { return _count; }
+  bool    empty() const { return _count == 0; }
+  void    reserve(size_t) {}
+  void    shrink() {}
+
+private:
+  static SiblingLinks& links(Node &node) { return node._links; }
+
+  Node     *_first = nullptr;
+  Node     *_last = nullptr;
+  Node     *_next = nullptr;
+  Node     *_previous = nullptr;
+  uint32_t  _count = 0;
+};
+
+#pragma mark - VectorLinks Template Implementation
+
+template <typename N>
+void VectorLinks<N>::append(N &child, const Ref &)
+{
+  if (_children.size() == _children.capacity())
+  {
+    TREENT_STAT_ADD(childReallocations, 1);
+  }
+  _children.push_back(&child);
+}
+
+template <typename N>
+void VectorLinks<N>::remove(N &child)
+{
+  // Search from the back: children are often removed in reverse order of being added,
+  // as when a subtree is unloaded leaves first.
+  auto it = std::find(_children.rbegin(), _children.rend(), &child);
+  if (it != _children.rend())
+  {
+    _children.erase(std::next(it).base());
+  }
+}
+
+template <typename N>
+template <typename F>
+void VectorLinks<N>::each(F &&fn) const
+{
+  for (auto node : _children)
+  {
+    fn(*node);
+  }
+}
+
+template <typename N>
+template <typename F>
+void VectorLinks<N>::eachReversed(F &&fn) const
+{
+  for (auto it = _children.rbegin(); it != _children.rend(); ++it)
+  {
+    fn(**it);
+  }
+}
+
+#pragma mark - SiblingLinks Template Implementation
+
+template <typename N>
+void SiblingLinks<N>::append(N &child, const Ref &)
+{
+  auto &links = SiblingLinks::links(child);
+  links._previous = _last;
+  links._next = nullptr;
+
+  if (_last)
+  {
+    SiblingLinks::links(*_last)._next = &child;
+  }
+  else
+  {
+    _first = &child;
+  }
+  _last = &child;
+  _count += 1;
+}
+
+template <typename N>
+void SiblingLinks<N>::remove(N &child)
+{
+  auto &links = SiblingLinks::links(child);
+
+  if (links._previous)
+  {
+    SiblingLinks::links(*links._previous)._next = links._next;
+  }
+  else
+  {
+    _first = links._next;
+  }
+
+  if (links._next)
+  {
+    SiblingLinks::links(*links._next)._previous = links._previous;
+  }
+  else
+  {
+    _last = links._previous;
+  }
+
+  links._previous = nullptr;
+  links._next = nullptr;
+  _count -= 1;
+}
+
+template <typename N>
+void SiblingLinks<N>::clear()
+{
+  auto node = _first;
+  while (node)
+  {
+    auto &links = SiblingLinks::links(*node);
+    node = links._next;
+    links._previous = nullptr;
+    links._next = nullptr;
+  }
+  _first = nullptr;
+  _last = nullptr;
+  _count = 0;
+}
+
+template <typename N>
+template <typename F>
+void SiblingLinks<N>::each(F &&fn) const
+{
+  for (auto node = _first; node; node = SiblingLinks::links(*node)._next)
+  {
+    fn(*node);
+  }
+}
+
+template <typename N>
+template <typename F>
+void SiblingLinks<N>::eachReversed(F &&fn) const
+{
+  for (auto node = _last; node; node = SiblingLinks::links(*node)._previous)
+  {
+    fn(*node);
+  }
+}
+
+} // namespace treent
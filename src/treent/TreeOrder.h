@@ -0,0 +1,905 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "entityx/Entity.h"
+#include "BatchCompose.h"
+#include "TaskPool.h"
+#include "TreeChanges.h"
+#include "TreeStats.h"
+#include "detail/ManagerRegistry.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace treent
+{
+
+template <typename Derived>
+class TreeSpan;
+enum class Evaluation;
+
+///
+/// A flattened, parent-before-child ordering of every TreeComponent<Derived> tree.
+/// Nodes are stored as raw component pointers alongside the index of their parent,
+/// so the whole forest can be composed in one linear pass over contiguous memory
+/// instead of recursing through component handles.
+///
+/// The order is rebuilt lazily, the first time it is used after the topology of any
+/// tree of Derived components has changed. Rebuilding walks the trees once from their
+/// roots; composing afterwards never touches the entity manager.
+///
+/// The order also owns the world values of its components, in a dense array that is
+/// laid out in the same order as the nodes. Composing is then a one-way kernel that
+/// reads local values and writes world values: world[i] = compose(world[parent[i]], local[i]).
+/// Components composed between rebuilds (through descend() or ascend()) have their
+/// world values appended until the next rebuild moves them into place.
+///
+/// Along with each node's parent, the order stores the size of its subtree. Since trees
+/// are laid out depth-first, a subtree is the contiguous range [i, i + size), which lets
+/// descendDirty() skip clean branches in a single jump, and descendants() return a
+/// TreeSpan over the dense arrays instead of walking child lists.
+///
+/// Sibling subtrees don't depend on each other, so both passes can also run on a TaskPool.
+/// Runs of small sibling subtrees are batched into tasks of roughly grainSize nodes, while
+/// subtrees larger than that are forked once their root has been composed.
+///
+/// For wide, shallow forests, descendLevels() composes one depth level at a time instead.
+/// It keeps a breadth-first copy of the order and stores world values as structure-of-arrays
+/// lanes, so components with a BatchCompose specialization are composed several nodes per
+/// instruction.
+///
+/// Each EntityManager gets its own order, so separate worlds can be composed on separate
+/// threads. Components created through TreentT are bound to the order of their manager;
+/// children join their parent's order when attached. Trees linked before being bound wait in
+/// the unbound order's index until the order of the manager that owns their root adopts them.
+///
+template <typename Derived>
+class TreeOrder
+{
+public:
+  using World = typename Derived::World;
+
+  /// Index stored as the parent of root nodes.
+  static const uint32_t npos = UINT32_MAX;
+  /// Number of nodes below which parallel passes stop forking subtrees.
+  static const size_t   DefaultGrainSize = 4096;
+
+  /// The order used by TreeComponent<Derived> instances not yet bound to a manager's order.
+  static TreeOrder& instance();
+  /// The order of the Derived components in \a entities.
+  /// Safe to call from any thread; each order is then used by one thread at a time.
+  static TreeOrder& instance(const entityx::EntityManager &entities);
+  /// Destroy the order of \a entities. Call once the manager's components are gone; see TreentT::release().
+  static void       release(const entityx::EntityManager &entities) { detail::ManagerRegistry<TreeOrder>::release(entities); }
+  /// Invalidate every order. Used when a component changes topology before it is bound.
+  static void       invalidateAll();
+
+  /// Mark the order as out of date. Called by TreeComponent when the topology changes.
+  void invalidate() { _valid.store(false, std::memory_order_relaxed); }
+  bool valid() const { return _valid.load(std::memory_order_relaxed); }
+
+  /// Note that a component was marked dirty since the last pass. Called by TreeComponent::markDirty().
+  void markDirty() { _clean.store(false, std::memory_order_relaxed); }
+  /// True when every component in the order was composed by the most recent pass and none
+  /// has been marked dirty since, so every stored world value is current.
+  bool clean() const { return _clean.load(std::memory_order_relaxed); }
+
+  /// Called with its context whenever a node in the order is marked dirty.
+  using DirtyObserver = void (*)(void *context, Derived &node);
+  /// Have \a observer(context, node) called whenever a node in this order is marked dirty,
+  /// so components that derive data from ours can track what changed. Registering the same
+  /// observer and context again does nothing. Observers are dropped with the order.
+  void observeDirty(DirtyObserver observer, void *context);
+
+  /// Rebuild the order from the trees in \a entities if it is out of date.
+  /// Starts from the root index, plus any unbound trees whose roots belong to \a entities;
+  /// never scans the component pool.
+  void update(entityx::EntityManager &entities);
+
+  /// Roots of every tree in this order, kept up to date as components are attached,
+  /// detached and destroyed. Lone components aren't listed. In no particular order.
+  const std::vector<Derived*>&  roots() const { return _roots; }
+  /// Bound components with neither parent nor children, kept up to date the same way.
+  /// In no particular order.
+  const std::vector<Derived*>&  lone() const { return _lone; }
+
+  /// Compose every tree in \a entities in a single parents-before-children pass.
+  /// Equivalent to calling descend() on every root.
+  void descendAll(entityx::EntityManager &entities);
+  /// Compose only the dirty subtrees in \a entities, skipping clean branches.
+  void descendDirty(entityx::EntityManager &entities);
+
+  /// Compose every tree in \a entities, spreading independent subtrees across \a pool.
+  void descendAll(entityx::EntityManager &entities, TaskPool &pool, size_t grainSize = DefaultGrainSize);
+  /// Compose the dirty subtrees in \a entities, spreading independent subtrees across \a pool.
+  void descendDirty(entityx::EntityManager &entities, TaskPool &pool, size_t grainSize = DefaultGrainSize);
+
+  /// Compose every tree in \a entities level by level, using BatchCompose<Derived> kernels.
+  /// Same result as descendAll(); only available for components that specialize BatchCompose.
+  void descendLevels(entityx::EntityManager &entities);
+
+  /// Number of nodes composed by the most recent descendAll() or descendDirty().
+  size_t                        composedCount() const { return _composedCount; }
+  /// Number of nodes examined by the most recent pass, composed or not.
+  size_t                        visitedCount() const { return _visitedCount; }
+  /// Hierarchy change log of our EntityManager, or null for the unbound order.
+  TreeChangeLog*                changes() const { return _changes; }
+  /// Depth and tree sizes of the forest as of the last rebuild. Walks every node once.
+  TreeShape                     shape() const;
+
+  /// Changes every time the order is rebuilt, so passes can tell when the layout moved.
+  uint32_t                      generation() const { return _generation; }
+  size_t                        size() const { return _nodes.size(); }
+  const std::vector<Derived*>&  nodes() const { return _nodes; }
+  const std::vector<uint32_t>&  parents() const { return _parents; }
+  const std::vector<uint32_t>&  subtreeSizes() const { return _sizes; }
+  /// World values, in node order for the first size() entries.
+  const std::vector<World>&     worlds() const { return _world; }
+
+  /// Returns the world value last composed for \a node.
+  World                         world(const Derived &node) const;
+  /// Stores the world value of \a node, giving it a slot in the world array if needed.
+  void                          setWorld(Derived &node, const World &world);
+  /// The descendants of \a node as laid out by the last rebuild, or an empty span if the
+  /// order is out of date or \a node isn't part of a tree. See update().
+  TreeSpan<Derived>             descendants(const Derived &node) const;
+
+private:
+  TreeOrder() = default;
+  template <typename, typename, typename, template <typename> class, Evaluation> friend struct TreeComponent;
+
+  /// Root index maintenance, called by TreeComponent as trees gain and lose their roots.
+  /// Components on any thread may update the unbound order's index, so it takes a lock.
+  void addRoot(Derived &root);
+  void removeRoot(Derived &root);
+  void eraseRoot(Derived &root);
+  /// Tell our observers that \a node was marked dirty. Called by TreeComponent::markDirty().
+  void notifyDirty(Derived &node) { for (auto &observer : _dirtyObservers) { observer.first(observer.second, node); } }
+  /// Lone index maintenance. Only bound orders list lone nodes, so these don't lock.
+  void addLone(Derived &node);
+  void removeLone(Derived &node);
+  static std::mutex& unboundMutex();
+  /// Append the trees in the unbound order's index whose roots belong to \a entities,
+  /// taking them out of that index. Rebuilding then binds them to us.
+  void adoptUnboundRoots(entityx::EntityManager &entities);
+
+  static TreeOrder* create(const entityx::EntityManager &entities);
+  /// Generations are unique across all orders of Derived, so a slot can't be mistaken for one in another order.
+  static uint32_t  nextGeneration();
+
+  /// Rebuilding: clear the layout, append the tree of each root, then hand out slots.
+  void beginRebuild();
+  void finishRebuild(entityx::EntityManager &entities);
+  void appendTree(Derived *root);
+  /// Compose the nodes in [begin, end) with their parents and mark them clean.
+  void composeRange(size_t begin, size_t end);
+  /// Find the dirty subtrees and pass each one's range to \a fn.
+  template <typename F>
+  void forEachDirtyRange(F &&fn);
+  /// Compose [begin, end), a run of sibling subtrees whose parent is already composed.
+  /// Large subtrees are forked onto \a pool after composing their root.
+  void spawnSiblings(TaskPool &pool, size_t begin, size_t end, size_t grainSize, std::atomic<size_t> &composed);
+  /// Build the breadth-first copy of the order used by descendLevels().
+  void buildLevels();
+  bool hasSlot(const Derived &node) const { return node._slot != npos && node._generation == _generation; }
+
+  std::vector<Derived*>                       _roots;
+  std::vector<Derived*>                       _lone;
+  std::vector<std::pair<DirtyObserver, void*>> _dirtyObservers;
+  std::vector<Derived*>                       _nodes;
+  std::vector<uint32_t>                       _parents;
+  std::vector<uint32_t>                       _sizes;
+  std::vector<World>                          _world;
+  std::vector<World>                          _previousWorld;
+  std::vector<std::pair<Derived*, uint32_t>>  _stack;
+  /// Breadth-first layout: node indices by depth, the level-order position of their
+  /// parents, where each level begins, and world values as lanes in level order.
+  std::vector<uint32_t>                       _levelNodes;
+  std::vector<uint32_t>                       _levelParents;
+  std::vector<size_t>                         _levelOffsets;
+  std::vector<float>                          _levelWorld;
+  std::vector<float>                          _levelScratch;
+  bool                                        _levelsValid = false;
+  entityx::EntityManager                     *_entities = nullptr;
+  TreeChangeLog                              *_changes = nullptr;
+  size_t                                      _composedCount = 0;
+  size_t                                      _visitedCount = 0;
+  uint32_t                                    _generation = nextGeneration();
+  std::atomic<bool>                           _valid { false };
+  std::atomic<bool>                           _clean { false };
+};
+
+///
+/// A contiguous, depth-first range of a TreeOrder, such as the descendants of a node.
+/// Iterating a span is a linear scan over the order's arrays, and each node's subtree
+/// is the run of nodes that follows it, subtreeSize(i) long.
+///
+/// A span refers into its order, so it is only valid until the order is rebuilt.
+/// Its world values are as of the most recent pass; they are all current while the
+/// order is clean().
+///
+/// for (auto *style : panel.descendants<StyleComponent>())
+///
+template <typename Derived>
+class TreeSpan
+{
+public:
+  using Local = typename Derived::Local;
+  using World = typename Derived::World;
+  using iterator = Derived* const*;
+
+  /// Index returned by parent() for nodes whose parent isn't in the span.
+  static const uint32_t npos = TreeOrder<Derived>::npos;
+
+  TreeSpan() = default;
+
+  iterator      begin() const { return _nodes; }
+  iterator      end() const { return _nodes + _size; }
+  size_t        size() const { return _size; }
+  bool          empty() const { return _size == 0; }
+  Derived&      operator[] (size_t i) const { return *_nodes[i]; }
+
+  /// World values of the nodes, in the same order.
+  const World*  worlds() const { return _worlds; }
+  /// Position in this span of node \a i's parent, or npos for the first level of the span.
+  uint32_t      parent(size_t i) const { return (_parents[i] >= _offset && _parents[i] != npos) ? _parents[i] - _offset : npos; }
+  /// Number of nodes in node \a i's subtree, itself included.
+  uint32_t      subtreeSize(size_t i) const { return _sizes[i]; }
+
+  /// Passes the local value of every node to \a fn for modification, marking each one dirty.
+  template <typename F>
+  void          editLocals(F &&fn) const;
+  /// Sets every node's local value to \a local.
+  void          setLocals(const Local &local) const { editLocals([&local] (Local &l) { l = local; }); }
+  /// Flags every node for recomposition by descendDirty().
+  void          markDirty() const;
+
+private:
+  friend class TreeOrder<Derived>;
+  TreeSpan(const TreeOrder<Derived> &order, size_t begin, size_t end);
+
+  Derived* const *_nodes = nullptr;
+  const uint32_t *_parents = nullptr;
+  const uint32_t *_sizes = nullptr;
+  const World    *_worlds = nullptr;
+  size_t          _size = 0;
+  uint32_t        _offset = 0;
+};
+
+#pragma mark - TreeOrder Template Implementation
+
+template <typename D>
+auto TreeOrder<D>::descendants(const D &node) const -> TreeSpan<D>
+{
+  if (! valid() || ! hasSlot(node) || node._slot >= _nodes.size())
+  {
+    return TreeSpan<D>();
+  }
+  return TreeSpan<D>(*this, node._slot + 1, node._slot + _sizes[node._slot]);
+}
+
+template <typename D>
+const uint32_t TreeOrder<D>::npos;
+template <typename D>
+const size_t TreeOrder<D>::DefaultGrainSize;
+
+template <typename D>
+TreeOrder<D>& TreeOrder<D>::instance()
+{
+  static TreeOrder sInstance;
+  return sInstance;
+}
+
+template <typename D>
+TreeOrder<D>& TreeOrder<D>::instance(const entityx::EntityManager &entities)
+{
+  return detail::ManagerRegistry<TreeOrder>::get(entities, &TreeOrder::create);
+}
+
+template <typename D>
+TreeOrder<D>* TreeOrder<D>::create(const entityx::EntityManager &entities)
+{
+  auto order = new TreeOrder;
+  order->_changes = &TreeChangeLog::instance(entities);
+  return order;
+}
+
+template <typename D>
+void TreeOrder<D>::invalidateAll()
+{
+  instance().invalidate();
+  detail::ManagerRegistry<TreeOrder>::each([] (TreeOrder &order) { order.invalidate(); });
+}
+
+template <typename D>
+uint32_t TreeOrder<D>::nextGeneration()
+{
+  static std::atomic<uint32_t> sGeneration(1);
+  return sGeneration.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename D>
+void TreeOrder<D>::update(entityx::EntityManager &entities)
+{
+  if (valid() && _entities == &entities)
+  {
+    return;
+  }
+
+  beginRebuild();
+  for (auto root : _roots)
+  {
+    appendTree(root);
+  }
+  if (this != &instance())
+  {
+    // Trees built before being bound to a manager live in the unbound order's index.
+    adoptUnboundRoots(entities);
+  }
+  finishRebuild(entities);
+}
+
+template <typename D>
+void TreeOrder<D>::adoptUnboundRoots(entityx::EntityManager &entities)
+{
+  auto &unbound = instance();
+  std::lock_guard<std::mutex> lock(unboundMutex());
+  for (size_t i = 0; i < unbound._roots.size();)
+  {
+    // Roots learn their entity's id when they gain a child; our pool then tells us whether they are ours.
+    auto root = unbound._roots[i];
+    if (entities.valid(root->_id) && entities.component<D>(root->_id).get() == root)
+    {
+      unbound.eraseRoot(*root);
+      appendTree(root);
+    }
+    else
+    {
+      i += 1;
+    }
+  }
+}
+
+template <typename D>
+std::mutex& TreeOrder<D>::unboundMutex()
+{
+  static std::mutex sMutex;
+  return sMutex;
+}
+
+template <typename D>
+void TreeOrder<D>::addRoot(D &root)
+{
+  std::unique_lock<std::mutex> lock(unboundMutex(), std::defer_lock);
+  if (this == &instance())
+  {
+    lock.lock();
+  }
+  root._rootIndex = static_cast<uint32_t>(_roots.size());
+  _roots.push_back(&root);
+}
+
+template <typename D>
+void TreeOrder<D>::removeRoot(D &root)
+{
+  std::unique_lock<std::mutex> lock(unboundMutex(), std::defer_lock);
+  if (this == &instance())
+  {
+    lock.lock();
+  }
+  eraseRoot(root);
+}
+
+template <typename D>
+void TreeOrder<D>::eraseRoot(D &root)
+{
+  // Swap the last root into the hole.
+  auto last = _roots.back();
+  _roots[root._rootIndex] = last;
+  last->_rootIndex = root._rootIndex;
+  _roots.pop_back();
+  root._rootIndex = npos;
+}
+
+template <typename D>
+void TreeOrder<D>::observeDirty(DirtyObserver observer, void *context)
+{
+  const auto entry = std::make_pair(observer, context);
+  if (std::find(_dirtyObservers.begin(), _dirtyObservers.end(), entry) == _dirtyObservers.end())
+  {
+    _dirtyObservers.push_back(entry);
+  }
+}
+
+template <typename D>
+void TreeOrder<D>::addLone(D &node)
+{
+  node._loneIndex = static_cast<uint32_t>(_lone.size());
+  _lone.push_back(&node);
+}
+
+template <typename D>
+void TreeOrder<D>::removeLone(D &node)
+{
+  auto last = _lone.back();
+  _lone[node._loneIndex] = last;
+  last->_loneIndex = node._loneIndex;
+  _lone.pop_back();
+  node._loneIndex = npos;
+}
+
+template <typename D>
+void TreeOrder<D>::beginRebuild()
+{
+  _nodes.clear();
+  _parents.clear();
+  _sizes.clear();
+}
+
+template <typename D>
+void TreeOrder<D>::finishRebuild(entityx::EntityManager &entities)
+{
+  // Carry world values over to their new positions, then hand out the new slots.
+  _previousWorld.swap(_world);
+  _world.clear();
+  _world.reserve(_nodes.size());
+  for (auto node : _nodes)
+  {
+    _world.push_back(hasSlot(*node) ? _previousWorld[node->_slot] : D::compose(World(), node->_local));
+  }
+
+  _generation = nextGeneration();
+  for (size_t i = 0; i < _nodes.size(); ++i)
+  {
+    auto node = _nodes[i];
+    if (node->_order != this)
+    {
+      // Bind adopted nodes, moving roots over to our index.
+      if (node->_rootIndex != npos)
+      {
+        (node->_order ? *node->_order : instance()).removeRoot(*node);
+      }
+      // Their world values stayed behind in the old order.
+      node->_order = this;
+      node->_dirty = true;
+      markDirty();
+      if (_parents[i] == npos)
+      {
+        addRoot(*node);
+      }
+    }
+    node->_slot = static_cast<uint32_t>(i);
+    node->_generation = _generation;
+  }
+
+  _entities = &entities;
+  _valid.store(true, std::memory_order_relaxed);
+  _levelsValid = false;
+  TREENT_STAT_ADD(rebuilds, 1);
+}
+
+template <typename D>
+void TreeOrder<D>::appendTree(D *root)
+{
+  const auto begin = _nodes.size();
+  _stack.clear();
+  _stack.emplace_back(root, npos);
+
+  while (! _stack.empty())
+  {
+    auto node = _stack.back();
+    _stack.pop_back();
+
+    auto index = static_cast<uint32_t>(_nodes.size());
+    _nodes.push_back(node.first);
+    _parents.push_back(node.second);
+    _sizes.push_back(1);
+
+    // Push in reverse so children come out of the stack in their original order.
+    node.first->_links.eachReversed([this, index] (D &child) { _stack.emplace_back(&child, index); });
+  }
+
+  // Children follow their parents, so accumulating back to front totals every subtree.
+  for (size_t i = _nodes.size() - 1; i > begin; --i)
+  {
+    _sizes[_parents[i]] += _sizes[i];
+  }
+}
+
+template <typename D>
+void TreeOrder<D>::descendAll(entityx::EntityManager &entities)
+{
+  TREENT_STAT_TIMER(propagationNanoseconds);
+  update(entities);
+
+  _visitedCount = _nodes.size();
+  composeRange(0, _nodes.size());
+  _composedCount = _nodes.size();
+  _clean.store(true, std::memory_order_relaxed);
+  TREENT_STAT_ADD(composed, _composedCount);
+}
+
+template <typename D>
+void TreeOrder<D>::descendDirty(entityx::EntityManager &entities)
+{
+  TREENT_STAT_TIMER(propagationNanoseconds);
+  update(entities);
+
+  _composedCount = 0;
+  forEachDirtyRange([this] (size_t begin, size_t end) {
+    composeRange(begin, end);
+    _composedCount += end - begin;
+  });
+  _clean.store(true, std::memory_order_relaxed);
+  TREENT_STAT_ADD(composed, _composedCount);
+}
+
+template <typename D>
+void TreeOrder<D>::descendAll(entityx::EntityManager &entities, TaskPool &pool, size_t grainSize)
+{
+  TREENT_STAT_TIMER(propagationNanoseconds);
+  update(entities);
+
+  std::atomic<size_t> composed(0);
+  spawnSiblings(pool, 0, _nodes.size(), grainSize, composed);
+  pool.wait();
+
+  _visitedCount = _nodes.size();
+  _composedCount = composed;
+  _clean.store(true, std::memory_order_relaxed);
+  TREENT_STAT_ADD(composed, _composedCount);
+}
+
+template <typename D>
+void TreeOrder<D>::descendDirty(entityx::EntityManager &entities, TaskPool &pool, size_t grainSize)
+{
+  TREENT_STAT_TIMER(propagationNanoseconds);
+  update(entities);
+
+  std::atomic<size_t> composed(0);
+  forEachDirtyRange([&] (size_t begin, size_t end) {
+    spawnSiblings(pool, begin, end, grainSize, composed);
+  });
+  pool.wait();
+
+  _composedCount = composed;
+  _clean.store(true, std::memory_order_relaxed);
+  TREENT_STAT_ADD(composed, _composedCount);
+}
+
+template <typename D>
+void TreeOrder<D>::spawnSiblings(TaskPool &pool, size_t begin, size_t end, size_t grainSize, std::atomic<size_t> &composed)
+{
+  auto batchBegin = begin;
+  auto flush = [&] (size_t batchEnd) {
+    if (batchEnd > batchBegin)
+    {
+      pool.spawn([this, batchBegin, batchEnd, &composed] {
+        composeRange(batchBegin, batchEnd);
+        composed += batchEnd - batchBegin;
+      });
+    }
+  };
+
+  auto i = begin;
+  while (i < end)
+  {
+    const auto size = _sizes[i];
+    if (size > grainSize)
+    {
+      flush(i);
+      pool.spawn([this, &pool, i, size, grainSize, &composed] {
+        composeRange(i, i + 1);
+        composed += 1;
+        spawnSiblings(pool, i + 1, i + size, grainSize, composed);
+      });
+      i += size;
+      batchBegin = i;
+    }
+    else
+    {
+      i += size;
+      if (i - batchBegin >= grainSize)
+      {
+        flush(i);
+        batchBegin = i;
+      }
+    }
+  }
+  flush(end);
+}
+
+template <typename D>
+template <typename F>
+void TreeOrder<D>::forEachDirtyRange(F &&fn)
+{
+  _visitedCount = 0;
+
+  const auto count = _nodes.size();
+  size_t i = 0;
+  while (i < count)
+  {
+    auto node = _nodes[i];
+    _visitedCount += 1;
+
+    if (node->_dirty)
+    {
+      // Everything below a dirty node depends on it, so recompose the whole range.
+      fn(i, i + _sizes[i]);
+      i += _sizes[i];
+    }
+    else if (node->_dirtyDescendants)
+    {
+      node->_dirtyDescendants = false;
+      i += 1;
+    }
+    else
+    {
+      i += _sizes[i];
+    }
+  }
+}
+
+template <typename D>
+void TreeOrder<D>::composeRange(size_t begin, size_t end)
+{
+  const auto identity = World();
+  const auto nodes = _nodes.data();
+  const auto parents = _parents.data();
+  const auto world = _world.data();
+  for (size_t i = begin; i < end; ++i)
+  {
+    auto node = nodes[i];
+    const auto &parentWorld = (parents[i] != npos) ? world[parents[i]] : identity;
+    world[i] = D::compose(parentWorld, node->_local);
+    node->_dirty = false;
+    node->_dirtyDescendants = false;
+  }
+}
+
+template <typename D>
+void TreeOrder<D>::buildLevels()
+{
+  if (_levelsValid)
+  {
+    return;
+  }
+
+  const auto count = _nodes.size();
+  // Parents precede their children, so depths fill in with one forward pass.
+  // The level parent array doubles as depth scratch until it is filled in below.
+  auto &depths = _levelParents;
+  depths.assign(count, 0);
+  size_t levelCount = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    depths[i] = (_parents[i] != npos) ? depths[_parents[i]] + 1 : 0;
+    levelCount = std::max<size_t>(levelCount, depths[i] + 1);
+  }
+
+  _levelOffsets.assign(levelCount + 1, 0);
+  for (size_t i = 0; i < count; ++i)
+  {
+    _levelOffsets[depths[i] + 1] += 1;
+  }
+  for (size_t l = 0; l < levelCount; ++l)
+  {
+    _levelOffsets[l + 1] += _levelOffsets[l];
+  }
+
+  // Counting sort by depth keeps each level in depth-first order, so parents are read forward.
+  std::vector<size_t> cursor(_levelOffsets.begin(), _levelOffsets.end() - 1);
+  std::vector<uint32_t> position(count);
+  _levelNodes.resize(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    auto p = cursor[depths[i]]++;
+    _levelNodes[p] = static_cast<uint32_t>(i);
+    position[i] = static_cast<uint32_t>(p);
+  }
+
+  _levelParents.resize(count);
+  for (size_t p = 0; p < count; ++p)
+  {
+    auto parent = _parents[_levelNodes[p]];
+    _levelParents[p] = (parent != npos) ? position[parent] : npos;
+  }
+
+  _levelsValid = true;
+}
+
+template <typename D>
+void TreeOrder<D>::descendLevels(entityx::EntityManager &entities)
+{
+  TREENT_STAT_TIMER(propagationNanoseconds);
+  using Batch = BatchCompose<D>;
+  const size_t fields = Batch::FieldCount;
+
+  update(entities);
+  buildLevels();
+
+  const auto count = _nodes.size();
+  const auto levelCount = _levelOffsets.empty() ? 0 : _levelOffsets.size() - 1;
+  size_t widest = 0;
+  for (size_t l = 0; l < levelCount; ++l)
+  {
+    widest = std::max(widest, _levelOffsets[l + 1] - _levelOffsets[l]);
+  }
+
+  _levelWorld.resize(fields * count);
+  _levelScratch.resize(2 * fields * widest);
+
+  float *world[Batch::FieldCount];
+  float *parentWorld[Batch::FieldCount];
+  float *local[Batch::FieldCount];
+  for (size_t f = 0; f < fields; ++f)
+  {
+    parentWorld[f] = _levelScratch.data() + f * widest;
+    local[f] = _levelScratch.data() + (fields + f) * widest;
+  }
+
+  const auto identity = World();
+  for (size_t l = 0; l < levelCount; ++l)
+  {
+    const auto begin = _levelOffsets[l];
+    const auto width = _levelOffsets[l + 1] - begin;
+
+    for (size_t k = 0; k < width; ++k)
+    {
+      auto node = _nodes[_levelNodes[begin + k]];
+      Batch::load(node->_local, local, k);
+
+      auto parent = _levelParents[begin + k];
+      if (parent != npos)
+      {
+        for (size_t f = 0; f < fields; ++f)
+        {
+          parentWorld[f][k] = _levelWorld[f * count + parent];
+        }
+      }
+      else
+      {
+        Batch::load(identity, parentWorld, k);
+      }
+      node->_dirty = false;
+      node->_dirtyDescendants = false;
+    }
+
+    for (size_t f = 0; f < fields; ++f)
+    {
+      world[f] = _levelWorld.data() + f * count + begin;
+    }
+    Batch::compose(world, parentWorld, local, width);
+  }
+
+  // Hand the results back to the depth-first world array.
+  for (size_t f = 0; f < fields; ++f)
+  {
+    world[f] = _levelWorld.data() + f * count;
+  }
+  for (size_t p = 0; p < count; ++p)
+  {
+    Batch::store(_world[_levelNodes[p]], world, p);
+  }
+
+  _visitedCount = count;
+  _composedCount = count;
+  _clean.store(true, std::memory_order_relaxed);
+  TREENT_STAT_ADD(composed, _composedCount);
+}
+
+template <typename D>
+TreeShape TreeOrder<D>::shape() const
+{
+  TreeShape shape;
+  shape.nodes = _nodes.size();
+
+  // Parents come before their children, so each depth is known by the time it is needed.
+  std::vector<uint32_t> depths(_nodes.size());
+  for (size_t i = 0; i < _nodes.size(); ++i)
+  {
+    if (_parents[i] == npos)
+    {
+      depths[i] = 0;
+      shape.treeSizes.push_back(_sizes[i]);
+    }
+    else
+    {
+      depths[i] = depths[_parents[i]] + 1;
+      shape.maxDepth = std::max<size_t>(shape.maxDepth, depths[i]);
+    }
+  }
+  return shape;
+}
+
+template <typename D>
+auto TreeOrder<D>::world(const D &node) const -> World
+{
+  if (hasSlot(node))
+  {
+    return _world[node._slot];
+  }
+  return D::compose(World(), node._local);
+}
+
+template <typename D>
+void TreeOrder<D>::setWorld(D &node, const World &world)
+{
+  if (hasSlot(node))
+  {
+    _world[node._slot] = world;
+  }
+  else
+  {
+    node._slot = static_cast<uint32_t>(_world.size());
+    node._generation = _generation;
+    _world.push_back(world);
+  }
+}
+
+#pragma mark - TreeSpan Template Implementation
+
+template <typename D>
+const uint32_t TreeSpan<D>::npos;
+
+template <typename D>
+TreeSpan<D>::TreeSpan(const TreeOrder<D> &order, size_t begin, size_t end)
+: _nodes(order.nodes().data() + begin),
+  _parents(order.parents().data() + begin),
+  _sizes(order.subtreeSizes().data() + begin),
+  _worlds(order.worlds().data() + begin),
+  _size(end - begin),
+  _offset(static_cast<uint32_t>(begin))
+{}
+
+template <typename D>
+template <typename F>
+void TreeSpan<D>::editLocals(F &&fn) const
+{
+  // Marking dirty stops climbing at the first flagged ancestor, so this stays linear.
+  for (auto node : *this)
+  {
+    fn(node->editLocal());
+  }
+}
+
+template <typename D>
+void TreeSpan<D>::markDirty() const
+{
+  // A dirty node's whole subtree is recomposed, so flagging the first level is enough.
+  for (size_t i = 0; i < _size; i += _sizes[i])
+  {
+    _nodes[i]->markDirty();
+  }
+}
+
+} // namespace treent
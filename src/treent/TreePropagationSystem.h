@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "entityx/Entity.h"
+#include "entityx/Event.h"
+#include "entityx/System.h"
+#include "TaskPool.h"
+#include "TreeChanges.h"
+#include "TreeOrder.h"
+#include <cassert>
+#include <chrono>
+#include <tuple>
+#include <vector>
+
+namespace treent
+{
+
+/// How TreePropagationSystem composes the trees of each component type.
+enum class PropagationStrategy
+{
+  /// Compose every node with descendAll().
+  All,
+  /// Compose only dirty subtrees with descendDirty().
+  Dirty,
+  /// descendAll() spread across a TaskPool.
+  ParallelAll,
+  /// descendDirty() spread across a TaskPool.
+  ParallelDirty
+};
+
+///
+/// Composes the world values of every Treent tree once per update().
+///
+/// Each update() brings the TreeOrder of every component type up to date from its
+/// own root index and composes it with the configured strategy. roots() hands out
+/// the first component type's index for whole-forest queries.
+///
+/// systems.add<TreePropagationSystem<TransformComponent, StyleComponent>>();
+///
+/// After composing, update() delivers the hierarchy changes recorded in the manager's
+/// TreeChangeLog since the last update as one TreeChangesEvent.
+///
+template <typename ... TreeComponents>
+class TreePropagationSystem : public entityx::System<TreePropagationSystem<TreeComponents...>>
+{
+  using FirstComponent = typename std::tuple_element<0, std::tuple<TreeComponents...>>::type;
+public:
+  explicit TreePropagationSystem(PropagationStrategy strategy = PropagationStrategy::Dirty)
+  : _strategy(strategy)
+  {}
+  /// Use a parallel strategy on \a pool, forking subtrees of at least \a grainSize nodes.
+  TreePropagationSystem(PropagationStrategy strategy, TaskPool &pool, size_t grainSize = TreeOrder<FirstComponent>::DefaultGrainSize)
+  : _strategy(strategy),
+    _pool(&pool),
+    _grainSize(grainSize)
+  {}
+
+  void update(entityx::EntityManager &entities, entityx::EventManager &events, entityx::TimeDelta dt) override;
+
+  PropagationStrategy                         strategy() const { return _strategy; }
+  void                                        setStrategy(PropagationStrategy strategy) { _strategy = strategy; }
+
+  /// The root of every tree in \a entities, in no particular order. Lone nodes without
+  /// children aren't trees and aren't listed. See TreeOrder::roots().
+  static const std::vector<FirstComponent*>&  roots(const entityx::EntityManager &entities) { return TreeOrder<FirstComponent>::instance(entities).roots(); }
+  /// Wall time taken by the most recent update(), in seconds.
+  double                                      lastUpdateDuration() const { return _lastUpdateDuration; }
+
+private:
+  template <typename C>
+  void propagate(entityx::EntityManager &entities);
+
+  PropagationStrategy _strategy;
+  TaskPool           *_pool = nullptr;
+  size_t              _grainSize = TreeOrder<FirstComponent>::DefaultGrainSize;
+  double              _lastUpdateDuration = 0.0;
+};
+
+#pragma mark - TreePropagationSystem Template Implementation
+
+template <typename ... TreeComponents>
+void TreePropagationSystem<TreeComponents...>::update(entityx::EntityManager &entities, entityx::EventManager &events, entityx::TimeDelta)
+{
+  const auto start = std::chrono::steady_clock::now();
+
+  int trees[] = { 0, (propagate<TreeComponents>(entities), 0)... };
+  (void)trees;
+  TreeChangeLog::instance(entities).flush(events);
+
+  _lastUpdateDuration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename ... TreeComponents>
+template <typename C>
+void TreePropagationSystem<TreeComponents...>::propagate(entityx::EntityManager &entities)
+{
+  auto &order = TreeOrder<C>::instance(entities);
+  order.update(entities);
+
+  switch (_strategy)
+  {
+    case PropagationStrategy::All:
+      order.descendAll(entities);
+      break;
+    case PropagationStrategy::Dirty:
+      order.descendDirty(entities);
+      break;
+    case PropagationStrategy::ParallelAll:
+      assert(_pool && "Parallel propagation needs a TaskPool.");
+      order.descendAll(entities, *_pool, _grainSize);
+      break;
+    case PropagationStrategy::ParallelDirty:
+      assert(_pool && "Parallel propagation needs a TaskPool.");
+      order.descendDirty(entities, *_pool, _grainSize);
+      break;
+  }
+}
+
+} // namespace treent
@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "Treent.h"
+#include "detail/Logging.h"
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace treent
+{
+
+template <typename ... TreeComponents>
+class TreeStreamT;
+
+///
+/// Compact binary snapshots of Treent subtrees, for shipping large levels and prefabs
+/// as data instead of building them node by node in code.
+///
+/// A snapshot stores the subtree's topology as depth-first parent and child count arrays,
+/// followed by the raw local values of each tree component, one contiguous blob per type.
+/// Tree components must therefore have trivially copyable Local types, like the 2d
+/// Transform and Style. Other components aren't saved.
+///
+/// load() only reads the snapshot bytes, so they can come straight from a memory-mapped
+/// file. It creates every entity with its child lists sized up front and links each node
+/// once, in the same way as TreentT::instantiate().
+///
+/// auto bytes = TreeSnapshot::save(level);
+/// ... write bytes to disk, later map the file ...
+/// auto copy = TreeSnapshot::load(entities, mapped, mappedSize);
+///
+/// Snapshots use the byte order and value layout of the machine that saved them.
+///
+template <typename ... TreeComponents>
+class TreeSnapshotT
+{
+public:
+  using Treent = TreentT<TreeComponents...>;
+
+  /// Appends a snapshot of the subtree under \a root to \a bytes.
+  static void                 save(const Treent &root, std::vector<uint8_t> &bytes);
+  /// Returns a snapshot of the subtree under \a root.
+  static std::vector<uint8_t> save(const Treent &root) { std::vector<uint8_t> bytes; save(root, bytes); return bytes; }
+
+  /// Returns true if \a data holds a complete snapshot of this set of tree components.
+  static bool                 valid(const void *data, size_t size);
+  /// Number of nodes in the snapshot at \a data, or zero if it isn't valid().
+  static size_t               nodeCount(const void *data, size_t size);
+
+  /// Creates an unparented copy of the snapshot at \a data in \a entities and returns its root.
+  /// Returns an invalid Treent if \a data isn't valid().
+  static Treent               load(EntityManager &entities, const void *data, size_t size);
+
+private:
+  friend class TreeStreamT<TreeComponents...>;
+
+  static const uint32_t Magic = 0x544e5254; // "TRNT"
+  static const uint32_t Version = 1;
+  static const uint32_t ComponentCount = sizeof...(TreeComponents);
+
+  /// Fixed-size start of a snapshot. Then come the Local size of each component,
+  /// the parent and child count of each node, and one blob of Local values per component.
+  struct Header
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t componentCount;
+    uint32_t nodeCount;
+  };
+
+  static size_t         byteSize(size_t nodeCount);
+  /// Copies the parent and child count arrays out of a snapshot of \a count nodes,
+  /// since mapped data need not be aligned for uint32_t. Returns false if a parent
+  /// doesn't come before its children, which load() relies on to link in one pass.
+  static bool           readTopology(const uint8_t *bytes, size_t count, std::vector<uint32_t> &parents, std::vector<uint32_t> &childCounts);
+
+  /// The topology of a snapshot and where its local values are, ready to build nodes from.
+  struct Reader
+  {
+    /// Returns false, leaving the reader empty, if \a data isn't valid().
+    bool open(const void *data, size_t size);
+    /// Assigns the tree components of node \a i to \a entity; see TreentT::buildFlattened().
+    void operator() (size_t i, Entity &entity, size_t childCount) const;
+
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> childCounts;
+    const uint8_t        *locals = nullptr;
+    size_t                count = 0;
+  };
+
+  template <typename C>
+  static void           saveLocals(const std::vector<Entity> &nodes, uint8_t *&out);
+  template <typename C>
+  static void           loadLocal(const uint8_t *&blob, size_t count, size_t i, Entity &entity, size_t childCount);
+};
+
+#pragma mark - TreeSnapshot Template Implementation
+
+template <typename ... TreeComponents>
+size_t TreeSnapshotT<TreeComponents...>::byteSize(size_t nodeCount)
+{
+  const size_t sizes[] = { 0, sizeof(typename TreeComponents::Local)... };
+  size_t locals = 0;
+  for (auto size : sizes)
+  {
+    locals += size;
+  }
+  return sizeof(Header) + ComponentCount * sizeof(uint32_t) + 2 * nodeCount * sizeof(uint32_t) + nodeCount * locals;
+}
+
+template <typename ... TreeComponents>
+void TreeSnapshotT<TreeComponents...>::save(const Treent &root, std::vector<uint8_t> &bytes)
+{
+  auto flat = Treent::flatten(root);
+  const auto count = flat.nodes.size();
+
+  const auto begin = bytes.size();
+  bytes.resize(begin + byteSize(count));
+  auto out = bytes.data() + begin;
+
+  const Header header = { Magic, Version, ComponentCount, static_cast<uint32_t>(count) };
+  const uint32_t localSizes[] = { 0, static_cast<uint32_t>(sizeof(typename TreeComponents::Local))... };
+  std::memcpy(out, &header, sizeof(Header));
+  out += sizeof(Header);
+  std::memcpy(out, localSizes + 1, ComponentCount * sizeof(uint32_t));
+  out += ComponentCount * sizeof(uint32_t);
+  std::memcpy(out, flat.parents.data(), count * sizeof(uint32_t));
+  out += count * sizeof(uint32_t);
+  std::memcpy(out, flat.childCounts.data(), count * sizeof(uint32_t));
+  out += count * sizeof(uint32_t);
+
+  int trees[] = { 0, (saveLocals<TreeComponents>(flat.nodes, out), 0)... };
+  (void)trees;
+}
+
+template <typename ... TreeComponents>
+template <typename C>
+void TreeSnapshotT<TreeComponents...>::saveLocals(const std::vector<Entity> &nodes, uint8_t *&out)
+{
+  using Local = typename C::Local;
+  static_assert(std::is_trivially_copyable<Local>::value, "TreeSnapshot can only store tree components with trivially copyable Local values.");
+
+  for (auto node : nodes)
+  {
+    // Nodes appended without this component get its default local value.
+    auto c = node.component<C>();
+    const Local local = c ? c->local() : Local();
+    std::memcpy(out, &local, sizeof(Local));
+    out += sizeof(Local);
+  }
+}
+
+template <typename ... TreeComponents>
+size_t TreeSnapshotT<TreeComponents...>::nodeCount(const void *data, size_t size)
+{
+  if (! data || size < sizeof(Header))
+  {
+    return 0;
+  }
+
+  Header header;
+  std::memcpy(&header, data, sizeof(Header));
+  if (header.magic != Magic || header.version != Version || header.componentCount != ComponentCount || header.nodeCount == 0)
+  {
+    return 0;
+  }
+  if (size < byteSize(header.nodeCount))
+  {
+    return 0;
+  }
+
+  const uint32_t localSizes[] = { 0, static_cast<uint32_t>(sizeof(typename TreeComponents::Local))... };
+  if (std::memcmp(static_cast<const uint8_t*>(data) + sizeof(Header), localSizes + 1, ComponentCount * sizeof(uint32_t)) != 0)
+  {
+    return 0;
+  }
+  return header.nodeCount;
+}
+
+template <typename ... TreeComponents>
+bool TreeSnapshotT<TreeComponents...>::readTopology(const uint8_t *bytes, size_t count, std::vector<uint32_t> &parents, std::vector<uint32_t> &childCounts)
+{
+  const auto topology = bytes + sizeof(Header) + ComponentCount * sizeof(uint32_t);
+  parents.resize(count);
+  childCounts.resize(count);
+  std::memcpy(parents.data(), topology, count * sizeof(uint32_t));
+  std::memcpy(childCounts.data(), topology + count * sizeof(uint32_t), count * sizeof(uint32_t));
+
+  if (parents[0] != UINT32_MAX)
+  {
+    return false;
+  }
+  // Child counts size every child list up front, so they must match the parents exactly.
+  std::vector<uint32_t> actual(count, 0);
+  for (size_t i = 1; i < count; ++i)
+  {
+    if (parents[i] >= i)
+    {
+      return false;
+    }
+    actual[parents[i]] += 1;
+  }
+  return actual == childCounts;
+}
+
+template <typename ... TreeComponents>
+bool TreeSnapshotT<TreeComponents...>::valid(const void *data, size_t size)
+{
+  const auto count = nodeCount(data, size);
+  std::vector<uint32_t> parents, childCounts;
+  return count > 0 && readTopology(static_cast<const uint8_t*>(data), count, parents, childCounts);
+}
+
+template <typename ... TreeComponents>
+auto TreeSnapshotT<TreeComponents...>::load(EntityManager &entities, const void *data, size_t size) -> Treent
+{
+  Reader reader;
+  if (! reader.open(data, size))
+  {
+    TREENT_WARN("TreeSnapshot: data is not a snapshot of these tree components.");
+    return Treent();
+  }
+
+  std::vector<Entity> nodes;
+  Treent::buildFlattened(entities, reader.parents.data(), reader.childCounts.data(), 0, reader.count, nodes, reader);
+  return Treent(&entities, nodes[0], typename Treent::Unchecked());
+}
+
+template <typename ... TreeComponents>
+bool TreeSnapshotT<TreeComponents...>::Reader::open(const void *data, size_t size)
+{
+  const auto bytes = static_cast<const uint8_t*>(data);
+  count = nodeCount(data, size);
+  if (count == 0 || ! readTopology(bytes, count, parents, childCounts))
+  {
+    *this = Reader();
+    return false;
+  }
+  locals = bytes + sizeof(Header) + ComponentCount * sizeof(uint32_t) + 2 * count * sizeof(uint32_t);
+  return true;
+}
+
+template <typename ... TreeComponents>
+void TreeSnapshotT<TreeComponents...>::Reader::operator() (size_t i, Entity &entity, size_t childCount) const
+{
+  auto blob = locals;
+  int trees[] = { 0, (loadLocal<TreeComponents>(blob, count, i, entity, childCount), 0)... };
+  (void)trees;
+}
+
+template <typename ... TreeComponents>
+template <typename C>
+void TreeSnapshotT<TreeComponents...>::loadLocal(const uint8_t *&blob, size_t count, size_t i, Entity &entity, size_t childCount)
+{
+  using Local = typename C::Local;
+  Local local;
+  std::memcpy(&local, blob + i * sizeof(Local), sizeof(Local));
+  blob += count * sizeof(Local);
+
+  auto c = entity.assign<C>();
+  c->setLocal(local);
+  c->reserveChildren(childCount);
+}
+
+} // namespace treent
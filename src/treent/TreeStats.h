@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace treent
+{
+
+///
+/// Counters gathered on the tree hot paths when TREENT_STATS is defined.
+/// Pull them once per frame with TreeStats::take() to graph them or find pathological prefabs.
+/// Without TREENT_STATS the counters are compiled out and take() always returns zeros.
+///
+/// The counters are process-wide: one set of totals covers every EntityManager and thread,
+/// since several counting sites, like child list growth, don't know their manager. When
+/// worlds run side by side, take() reports their sum; per-order figures are available from
+/// TreeOrder::composedCount() and TreeOrder::shape().
+///
+struct TreeStats
+{
+  /// Nodes composed by descend(), ascend() and the TreeOrder passes.
+  uint64_t  composed = 0;
+  /// Children attached to and detached from TreeComponent parents.
+  uint64_t  attached = 0;
+  uint64_t  detached = 0;
+  /// Child lists that had to grow their storage to fit another child.
+  uint64_t  childReallocations = 0;
+  /// TreeOrder rebuilds, each a walk over every tree of one component type.
+  uint64_t  rebuilds = 0;
+  /// Entities destroyed by batched subtree destruction.
+  uint64_t  destroyed = 0;
+  /// Time spent composing (TreeOrder passes and descend()) and destroying subtrees.
+  double    propagationSeconds = 0.0;
+  double    destructionSeconds = 0.0;
+
+  /// Returns the statistics gathered since the previous call, from every thread, and starts over.
+  static TreeStats take();
+};
+
+///
+/// Shape of the forest in a TreeOrder as of its last rebuild. See TreeOrder::shape().
+///
+struct TreeShape
+{
+  size_t              nodes = 0;
+  /// Depth of the deepest node; roots are at depth zero.
+  size_t              maxDepth = 0;
+  /// Node count of each tree, in order.
+  std::vector<size_t> treeSizes;
+};
+
+namespace detail
+{
+
+///
+/// Running totals behind TreeStats. Updated with relaxed atomics so any thread may count.
+///
+struct StatCounters
+{
+  std::atomic<uint64_t> composed { 0 };
+  std::atomic<uint64_t> attached { 0 };
+  std::atomic<uint64_t> detached { 0 };
+  std::atomic<uint64_t> childReallocations { 0 };
+  std::atomic<uint64_t> rebuilds { 0 };
+  std::atomic<uint64_t> destroyed { 0 };
+  std::atomic<uint64_t> propagationNanoseconds { 0 };
+  std::atomic<uint64_t> destructionNanoseconds { 0 };
+
+  static StatCounters& instance() { static StatCounters sCounters; return sCounters; }
+};
+
+///
+/// Adds the time from construction to destruction to a nanosecond counter.
+///
+class ScopedStatTimer
+{
+public:
+  explicit ScopedStatTimer(std::atomic<uint64_t> &counter)
+  : _counter(counter),
+    _start(std::chrono::steady_clock::now())
+  {}
+
+  ~ScopedStatTimer()
+  {
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start);
+    _counter.fetch_add(static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+  }
+
+private:
+  ScopedStatTimer(const ScopedStatTimer&) = delete;
+  ScopedStatTimer& operator=(const ScopedStatTimer&) = delete;
+
+  std::atomic<uint64_t>                 &_counter;
+  std::chrono::steady_clock::time_point  _start;
+};
+
+} // namespace detail
+
+#ifdef TREENT_STATS
+  #define TREENT_STAT_ADD( counter, count ) treent::detail::StatCounters::instance().counter.fetch_add(count, std::memory_order_relaxed)
+  #define TREENT_STAT_TIMER( counter ) treent::detail::ScopedStatTimer treentStatTimer( treent::detail::StatCounters::instance().counter )
+#else
+  #define TREENT_STAT_ADD( counter, count ) (void(sizeof(count)))
+  #define TREENT_STAT_TIMER( counter ) (void(0))
+#endif
+
+#pragma mark - TreeStats Implementation
+
+inline TreeStats TreeStats::take()
+{
+  auto &counters = detail::StatCounters::instance();
+  auto take = [] (std::atomic<uint64_t> &counter) { return counter.exchange(0, std::memory_order_relaxed); };
+
+  TreeStats stats;
+  stats.composed = take(counters.composed);
+  stats.attached = take(counters.attached);
+  stats.detached = take(counters.detached);
+  stats.childReallocations = take(counters.childReallocations);
+  stats.rebuilds = take(counters.rebuilds);
+  stats.destroyed = take(counters.destroyed);
+  stats.propagationSeconds = take(counters.propagationNanoseconds) / 1.0e9;
+  stats.destructionSeconds = take(counters.destructionNanoseconds) / 1.0e9;
+  return stats;
+}
+
+} // namespace treent
@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "TreeSnapshot.h"
+#include <chrono>
+#include <deque>
+#include <vector>
+
+namespace treent
+{
+
+///
+/// Loads and unloads large subtrees a slice at a time, so streaming a level in or
+/// out doesn't stall a frame.
+///
+/// load() creates the root of a snapshot right away and returns it; update() then
+/// builds its descendants parents first, within a node or time budget. The tree is
+/// consistent after every update(), just not finished. unload() detaches a subtree
+/// right away and update() destroys it leaves first, cancelling its load if it was
+/// still coming in.
+///
+/// TreeStream stream;
+/// auto level = stream.load(entities, mapped, mappedSize);
+/// parent.appendChild(level.entity());
+/// ... every frame ...
+/// stream.update(std::chrono::milliseconds(2));
+///
+/// Snapshot data must stay alive until its load is done. Nodes of a subtree being
+/// unloaded belong to the stream; don't reparent them elsewhere.
+///
+template <typename ... TreeComponents>
+class TreeStreamT
+{
+public:
+  using Treent = TreentT<TreeComponents...>;
+  using Snapshot = TreeSnapshotT<TreeComponents...>;
+  using Clock = std::chrono::steady_clock;
+
+  TreeStreamT() = default;
+  TreeStreamT(const TreeStreamT &other) = delete;
+  TreeStreamT& operator= (const TreeStreamT &rhs) = delete;
+  /// Completes all pending work.
+  ~TreeStreamT() { finish(); }
+
+  /// Creates the unparented root of the snapshot at \a data in \a entities and returns it.
+  /// Its descendants are created by later calls to update().
+  /// Returns an invalid Treent if \a data isn't a valid snapshot.
+  Treent load(EntityManager &entities, const void *data, size_t size);
+  /// Detaches \a root from its parent now and destroys its subtree over later calls to update().
+  void   unload(const Treent &root);
+
+  /// Creates or destroys up to \a nodeBudget nodes. Returns true if work remains.
+  bool   update(size_t nodeBudget);
+  /// Creates or destroys nodes until \a timeBudget is spent, checking the clock every
+  /// ChunkSize nodes. Returns true if work remains.
+  bool   update(Clock::duration timeBudget);
+  /// Completes all pending work.
+  void   finish() { while (step(SIZE_MAX) > 0) {} }
+
+  /// True if any load or unload is unfinished.
+  bool   busy() const { return ! _loads.empty() || ! _unloads.empty(); }
+  /// Number of nodes left to create or destroy.
+  size_t pendingNodes() const;
+  /// True if \a root was returned by load() and still has nodes to come.
+  bool   isLoading(const Treent &root) const;
+
+  /// Nodes handled between clock checks in the timed update().
+  static const size_t ChunkSize = 64;
+
+private:
+  struct Load
+  {
+    EntityManager                     *entities;
+    typename Snapshot::Reader         reader;
+    std::vector<Entity>               nodes;
+    size_t                            next;
+  };
+
+  /// Nodes of a detached subtree in depth-first order, destroyed from the back.
+  /// The last node is always a leaf and the last child of its parent, so unlinking it is O(1).
+  struct Unload
+  {
+    Entity              root;
+    /// Where to report the destroyed root, found while it could still be looked up.
+    TreeChangeLog      *log;
+    std::vector<Entity> nodes;
+  };
+
+  /// Does up to \a budget nodes of work, unloads first, and returns how many it did.
+  size_t step(size_t budget);
+  size_t loadNodes(Load &load, size_t budget);
+  size_t unloadNodes(Unload &unload, size_t budget);
+
+  std::deque<Load>    _loads;
+  std::deque<Unload>  _unloads;
+  /// Scratch list for destroying one node along with anything added under it.
+  std::vector<Entity> _subtree;
+};
+
+#pragma mark - TreeStream Template Implementation
+
+template <typename ... TreeComponents>
+auto TreeStreamT<TreeComponents...>::load(EntityManager &entities, const void *data, size_t size) -> Treent
+{
+  Load load;
+  if (! load.reader.open(data, size))
+  {
+    TREENT_WARN("TreeStream: data is not a snapshot of these tree components.");
+    return Treent();
+  }
+
+  load.entities = &entities;
+  load.nodes.reserve(load.reader.count);
+  load.next = 1;
+  Treent::buildFlattened(entities, load.reader.parents.data(), load.reader.childCounts.data(), 0, 1, load.nodes, load.reader);
+  auto root = Treent(&entities, load.nodes[0], typename Treent::Unchecked());
+  if (load.next < load.reader.count)
+  {
+    _loads.push_back(std::move(load));
+  }
+  return root;
+}
+
+template <typename ... TreeComponents>
+void TreeStreamT<TreeComponents...>::unload(const Treent &root)
+{
+  if (! root.valid())
+  {
+    return;
+  }
+
+  auto entity = root.entity();
+  auto loading = [&entity] (const Load &load) { return load.nodes[0] == entity; };
+  _loads.erase(std::remove_if(_loads.begin(), _loads.end(), loading), _loads.end());
+
+  Treent::detachFromParent(entity);
+  Unload unload;
+  unload.root = entity;
+  unload.log = Treent::changeLog(entity);
+  unload.nodes = std::move(Treent::flatten(root).nodes);
+  _unloads.push_back(std::move(unload));
+}
+
+template <typename ... TreeComponents>
+bool TreeStreamT<TreeComponents...>::update(size_t nodeBudget)
+{
+  step(nodeBudget);
+  return busy();
+}
+
+template <typename ... TreeComponents>
+bool TreeStreamT<TreeComponents...>::update(Clock::duration timeBudget)
+{
+  const auto deadline = Clock::now() + timeBudget;
+  while (step(ChunkSize) > 0 && Clock::now() < deadline)
+  {}
+  return busy();
+}
+
+template <typename ... TreeComponents>
+size_t TreeStreamT<TreeComponents...>::pendingNodes() const
+{
+  size_t pending = 0;
+  for (auto &unload : _unloads)
+  {
+    pending += unload.nodes.size();
+  }
+  for (auto &load : _loads)
+  {
+    pending += load.reader.count - load.next;
+  }
+  return pending;
+}
+
+template <typename ... TreeComponents>
+bool TreeStreamT<TreeComponents...>::isLoading(const Treent &root) const
+{
+  for (auto &load : _loads)
+  {
+    if (load.nodes[0] == root.entity())
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename ... TreeComponents>
+size_t TreeStreamT<TreeComponents...>::step(size_t budget)
+{
+  size_t done = 0;
+  while (done < budget && ! _unloads.empty())
+  {
+    auto &unload = _unloads.front();
+    done += unloadNodes(unload, budget - done);
+    if (unload.nodes.empty())
+    {
+      if (unload.log)
+      {
+        unload.log->record(TreeChange::Kind::Destroyed, unload.root, Entity());
+      }
+      _unloads.pop_front();
+    }
+  }
+  while (done < budget && ! _loads.empty())
+  {
+    auto &load = _loads.front();
+    done += loadNodes(load, budget - done);
+    if (load.next == load.reader.count)
+    {
+      _loads.pop_front();
+    }
+  }
+  return done;
+}
+
+template <typename ... TreeComponents>
+size_t TreeStreamT<TreeComponents...>::loadNodes(Load &load, size_t budget)
+{
+  // The root was destroyed out from under us; nothing left to attach to.
+  if (! load.nodes[0].valid())
+  {
+    load.next = load.reader.count;
+    return 1;
+  }
+
+  auto parents = load.reader.parents.data();
+  auto childCounts = load.reader.childCounts.data();
+  const auto begin = load.next;
+  const auto end = begin + std::min(budget, load.reader.count - begin);
+  for (auto i = begin; i < end; ++i)
+  {
+    // Skip nodes whose parent was destroyed during loading; their descendants follow suit.
+    if (load.nodes[parents[i]].valid())
+    {
+      Treent::buildFlattened(*load.entities, parents, childCounts, i, i + 1, load.nodes, load.reader);
+      // Nodes whose parents came in earlier head the subtrees this step adds.
+      if (parents[i] < begin)
+      {
+        Treent::recordChange(TreeChange::Kind::Attached, load.nodes[i], load.nodes[parents[i]]);
+      }
+    }
+    else
+    {
+      load.nodes.resize(i + 1);
+    }
+  }
+  load.next = end;
+  return end - begin;
+}
+
+template <typename ... TreeComponents>
+size_t TreeStreamT<TreeComponents...>::unloadNodes(Unload &unload, size_t budget)
+{
+  auto &nodes = unload.nodes;
+  size_t done = 0;
+  while (done < budget && ! nodes.empty())
+  {
+    auto node = nodes.back();
+    nodes.pop_back();
+    ++done;
+    if (node.valid())
+    {
+      _subtree.assign(1, node);
+      Treent::collectDescendants(_subtree);
+      Treent::unlink(node);
+      Treent::destroyCollected(_subtree, 0);
+    }
+  }
+  return done;
+}
+
+} // namespace treent
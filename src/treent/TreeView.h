@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "entityx/Entity.h"
+#include "TreeOrder.h"
+#include <cassert>
+
+namespace treent
+{
+
+///
+/// Iterates the entities that have an Ordered tree component and all of \a Components,
+/// parents before children, by walking Ordered's TreeOrder instead of the component pool.
+/// A draw or update pass sees every parent before its children in one forward scan.
+///
+/// TreeView<TransformComponent, StyleComponent>(entities).each([] (Entity entity, TransformComponent &transform, StyleComponent &style) {
+///   draw(transform.world(), style.world());
+/// });
+///
+/// Trees come first, depth-first in order of the TreeOrder. Lone components, with
+/// neither parent nor children, follow from the order's lone index in no particular
+/// order, since they have nothing to wait on. Neither walk scans the component pool.
+/// Components that were assigned directly and never bound to the manager's order by
+/// TreentT are only listed once they are linked into a tree.
+/// \a fn must not change the topology of the trees it is iterating.
+///
+template <typename Ordered, typename ... Components>
+class TreeView
+{
+public:
+  explicit TreeView(entityx::EntityManager &entities)
+  : _entities(entities)
+  {}
+
+  /// Calls \a fn(entity, ordered, components...) for each matching entity in hierarchy order.
+  /// Rebuilds the order first if the topology has changed.
+  template <typename F>
+  void each(F &&fn);
+
+  /// Calls \a fn(entity, ordered, components...) for the matching entities in trees only,
+  /// skipping lone components.
+  template <typename F>
+  void eachInTrees(F &&fn);
+
+private:
+  static bool hasComponents(entityx::Entity &entity);
+  template <typename F>
+  void visit(Ordered *node, F &fn);
+
+  entityx::EntityManager &_entities;
+};
+
+#pragma mark - TreeView Template Implementation
+
+template <typename Ordered, typename ... Components>
+bool TreeView<Ordered, Components...>::hasComponents(entityx::Entity &entity)
+{
+  const bool has[] = { true, entity.template has_component<Components>()... };
+  for (auto h : has)
+  {
+    if (! h)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Ordered, typename ... Components>
+template <typename F>
+void TreeView<Ordered, Components...>::visit(Ordered *node, F &fn)
+{
+  auto entity = _entities.get(node->entityId());
+  assert(entity.valid() && "Ordered tree component without a known entity.");
+  if (hasComponents(entity))
+  {
+    fn(entity, *node, *entity.template component<Components>().get()...);
+  }
+}
+
+template <typename Ordered, typename ... Components>
+template <typename F>
+void TreeView<Ordered, Components...>::eachInTrees(F &&fn)
+{
+  auto &order = TreeOrder<Ordered>::instance(_entities);
+  order.update(_entities);
+  for (auto node : order.nodes())
+  {
+    visit(node, fn);
+  }
+}
+
+template <typename Ordered, typename ... Components>
+template <typename F>
+void TreeView<Ordered, Components...>::each(F &&fn)
+{
+  eachInTrees(fn);
+  for (auto node : TreeOrder<Ordered>::instance(_entities).lone())
+  {
+    visit(node, fn);
+  }
+}
+
+} // namespace treent
@@ -4,32 +4,68 @@
 #include "ChildrenComponent.h"
 #include "ParentComponent.h"
 #include "TreentBase.h"
+#include "TreeChanges.h"
+#include "TreeOrder.h"
 #include "detail/Logging.h"
+#include "detail/ManagerRegistry.h"
+#include "detail/TraversalStack.h"
+#include <algorithm>
+#include <tuple>
+#include <vector>
 
 namespace treent
 {
 
+namespace detail
+{
+
+/// Subtrees of one EntityManager waiting for TreentT::flushDestroyed().
+struct DestroyQueue
+{
+  static DestroyQueue* create(const entityx::EntityManager &) { return new DestroyQueue; }
+
+  std::vector<entityx::Entity> roots;
+};
+
+} // namespace detail
+
 using entityx::Entity;
 using entityx::EntityManager;
 using entityx::ComponentHandle;
 
+template <typename ... TreeComponents>
+class TreentViewT;
+template <typename ... TreeComponents>
+class TreeSnapshotT;
+template <typename ... TreeComponents>
+class TreeStreamT;
+
 ///
 /// Treent manages a tree of entities that share a common set of tree components.
 /// Use to create prefab-like objects in your source code.
 ///
+/// A Treent belongs to an EntityManager, passed explicitly or taken from SharedEntities,
+/// and creates its children there. Separate managers can be built on separate threads,
+/// say a staging world for prefabs, then handed off whole.
+///
 template <typename ... TreeComponents>
 class TreentT : public TreentBase
 {
 public:
 	/// Constructs an invalid Treent.
 	TreentT() = default;
-	/// Constructs a Treent that wraps an entity.
+	/// Constructs a Treent that wraps an entity of the shared EntityManager.
   explicit TreentT(const Entity &entity);
-  /// Factory method for creating a base Treent.
-  static TreentT create() { return TreentT(entities().create()); }
+  /// Constructs a Treent that wraps an entity of \a entities.
+  TreentT(EntityManager &entities, const Entity &entity);
+  /// Factory method for creating a base Treent in the shared EntityManager.
+  static TreentT create() { return TreentT(sharedEntities()->create()); }
+  /// Factory method for creating a base Treent in \a entities.
+  static TreentT create(EntityManager &entities) { return TreentT(entities, entities.create()); }
   /// Factory method for creating a derived Treent. Parameters are passed after the entity.
+  /// To create one in another manager, open a SharedEntities::Scope first.
   template <typename Derived, typename ... Parameters>
-  static Derived create(Parameters&& ... params) { return Derived(entities().create(), std::forward<Parameters>(params)...); }
+  static Derived create(Parameters&& ... params) { return Derived(sharedEntities()->create(), std::forward<Parameters>(params)...); }
 
   //
   // Tree growing/pruning methods.
@@ -46,18 +82,55 @@ public:
   /// Appends a child to Treent, transferring ownership to the parent entity.
   void        appendChild(Entity &child);
 
+  /// Creates \a count copies of the \a prototype subtree as children of this Treent.
+  /// Local values of the tree components are copied, as are any extra Components listed.
+  /// The prototype is flattened once and child lists are sized up front, so stamping out
+  /// many copies costs one entity creation and one link per node.
+  template <typename ... Components>
+  std::vector<TreentT> instantiate(const TreentT &prototype, size_t count);
+
+  /// Creates an unparented copy of the \a prototype subtree. See instantiate().
+  template <typename ... Components>
+  static TreentT cloneSubtree(const TreentT &prototype) { return cloneSubtree<Components...>(prototype.entities(), prototype); }
+  /// Creates an unparented copy of the \a prototype subtree in \a entities.
+  template <typename ... Components>
+  static TreentT cloneSubtree(EntityManager &entities, const TreentT &prototype);
+
   /// Removes child from Treent.
   void        removeChild(Entity &child);
 
   /// Remove and destroy all children of Treent.
+  /// Descendants are destroyed in one batch, as in destroySubtree().
 	void				destroyChildren();
 
+  /// Destroy this Treent and all of its descendants.
+  /// The whole subtree is collected first and unlinked wholesale, so no node pays for
+  /// detaching from a parent that is being destroyed too. Much cheaper than letting
+  /// ChildrenComponent destroy children one at a time for large trees.
+  void        destroySubtree() { destroySubtree(entity()); }
+  static void destroySubtree(Entity &root);
+  /// Queue this Treent's subtree for destruction by the next flushDestroyed() of its manager.
+  /// Use when destroying right away is unsafe, like while visiting or iterating children.
+  void        destroyDeferred() { destroyQueue(entities()).push_back(entity()); }
+  /// Destroy every subtree of \a entities queued with destroyDeferred() in one batch.
+  /// Call at a safe point in that world's frame, e.g. after updating its systems.
+  static void flushDestroyed(EntityManager &entities);
+  /// Flush the queue of the shared EntityManager.
+  static void flushDestroyed() { flushDestroyed(*sharedEntities()); }
+  /// Destroy the subtrees of \a roots in one batch. Invalid and repeated roots are skipped,
+  /// as are roots that are descendants of other roots. Leaves \a roots empty.
+  static void destroySubtrees(std::vector<Entity> &roots);
+  /// Drop the orders of our tree components, the change log and the destroy queue kept for \a entities.
+  /// Call once its entities are destroyed, e.g. when throwing away a staging world;
+  /// otherwise they are kept for the life of the program.
+  static void release(const EntityManager &entities);
+
   /// Detach all Tree components of an entity.
   static void detachFromParent(Entity &child);
   void        detachFromParent() { detachFromParent(entity()); }
 
 	/// Safely destroys an entity that may or may not be a TreentT.
-  static void safeDestroy(Entity &entity) { detachFromParent(entity); entity.destroy(); }
+  static void safeDestroy(Entity &entity);
 
   //
   // Child iteration methods.
@@ -65,30 +138,105 @@ public:
   // To manipulate the children, use Systems that act on the relevant Components.
   //
 
-  const std::vector<Entity>& getChildren() { return component<ChildrenComponent>()->_children; }
+  ChildrenComponent::ChildList getChildren() { return component<ChildrenComponent>()->children(); }
 	bool isRoot() const { return ! hasComponent<ParentComponent>(); }
 
-  /// Recursively visit this Treend and all of its descendants, passing each to \a fn.
-  void visit(const std::function<void (TreentT)> &fn);
-	/// Recursively visit all of this Treent's descendants, passing each to \a fn.
-	void visitChildren(const std::function<void (TreentT)> &fn);
-
-  std::vector<Entity>::const_iterator begin() { return getChildren().begin(); }
-  std::vector<Entity>::const_iterator end() { return getChildren().end(); }
+  /// Make room for \a count children in the child lists of every tree component.
+  /// Nodes with up to TREENT_INLINE_CHILDREN children never need to reserve.
+  void        reserveChildren(size_t count);
+  /// Release unused child list capacity after removing children.
+  void        shrinkChildren();
+
+  /// Visit this Treent and all of its descendants depth-first, passing each to \a fn.
+  /// \a fn is any callable taking a TreentT; it is inlined rather than type-erased.
+  /// Traversal is iterative, so arbitrarily deep trees don't exhaust the call stack.
+  template <typename F>
+  void visit(F &&fn);
+	/// Visit all of this Treent's descendants depth-first, passing each to \a fn.
+  template <typename F>
+	void visitChildren(F &&fn);
+
+  /// The \a C components of all our descendants, depth-first, as a contiguous span of
+  /// C's TreeOrder. Rebuilds the order first if the topology has changed. C defaults
+  /// to the first tree component.
+  template <typename C = typename std::tuple_element<0, std::tuple<TreeComponents...>>::type>
+  TreeSpan<C> descendants() const;
+
+  /// Returns a lightweight view of this Treent for iteration.
+  TreentViewT<TreeComponents...> view() const { return TreentViewT<TreeComponents...>(_entities, entity()); }
+
+  ChildrenComponent::ChildList::const_iterator begin() { return getChildren().begin(); }
+  ChildrenComponent::ChildList::const_iterator end() { return getChildren().end(); }
 
 private:
+  friend class TreentViewT<TreeComponents...>;
+  friend class TreeSnapshotT<TreeComponents...>;
+  friend class TreeStreamT<TreeComponents...>;
+
+  /// Wraps an entity already known to be a Treent, without checking its components.
+  struct Unchecked {};
+  TreentT(EntityManager *entities, const Entity &entity, Unchecked)
+  : TreentBase(entities, entity)
+  {}
+
+  /// Assign missing components and bind the tree components to our manager's orders.
+  void        setup();
+  template <typename C>
+  void        bindOrder();
+
   /// Connect child tree components and set parent/children component relationship.
   void        attachChild(Entity &child);
+  /// Disconnect \a child from its parent without recording the change. Returns the former parent.
+  static Entity unlink(Entity &child);
+  /// The parent \a pc refers to, resolved against the manager of linked \a child.
+  static Entity parentOf(Entity &child, const ParentComponent &pc);
+  /// The TreeChangeLog of \a node's manager, or null if \a node isn't bound to one.
+  static TreeChangeLog* changeLog(Entity &node);
+  /// Note a change to the subtree under \a root in its manager's TreeChangeLog.
+  static void recordChange(TreeChange::Kind kind, Entity &root, const Entity &parent);
+
+  /// A subtree flattened depth-first, with the parent index and child count of each node.
+  struct Prototype
+  {
+    std::vector<Entity>   nodes;
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> childCounts;
+  };
+  static Prototype flatten(const TreentT &root);
+  /// Creates nodes [begin, end) of a subtree laid out depth-first in \a nodes, where node i
+  /// is a child of parents[i] and will get childCounts[i] children. \a assign(i, entity, childCount)
+  /// assigns the tree components of each node before it is linked. Nodes before \a begin must
+  /// exist already; node 0 is the root.
+  template <typename Assign>
+  static void    buildFlattened(EntityManager &entities, const uint32_t *parents, const uint32_t *childCounts, size_t begin, size_t end, std::vector<Entity> &nodes, Assign &&assign);
+  /// Creates one copy of \a prototype and returns its root.
+  template <typename ... Components>
+  static TreentT cloneFlattened(EntityManager &entities, Prototype &prototype, std::vector<Entity> &clones);
+  /// Copies the local value of C and reserves room for \a childCount children.
+  template <typename C>
+  static void cloneTreeComponent(Entity &source, Entity &clone, size_t childCount);
+  /// Copies C, if \a source has one.
+  template <typename C>
+  static void cloneComponent(Entity &source, Entity &clone);
+
+  /// Subtrees of \a entities waiting for flushDestroyed().
+  static std::vector<Entity>& destroyQueue(const EntityManager &entities) { return detail::ManagerRegistry<detail::DestroyQueue>::get(entities, &detail::DestroyQueue::create).roots; }
+  /// Appends the descendants of every entity in \a nodes to \a nodes, parents before children.
+  static void collectDescendants(std::vector<Entity> &nodes);
+  /// Clears every child list of the entities in \a nodes, then destroys nodes[first...] leaves first.
+  static void destroyCollected(std::vector<Entity> &nodes, size_t first);
+  //
+  // Per tree component steps, expanded over TreeComponents in a single pass
+  // with one component lookup per type.
+  //
 
+  template <typename C>
+  static void releaseTreeComponentChildren(Entity &entity);
   template <typename C>
   void        attachChildTreeComponent(Entity &child);
-  template <typename C1, typename C2, typename ... Components>
-  void        attachChildTreeComponent(Entity &child);
-
   template <typename C>
   static void detachTreeComponentFromParent(Entity &entity);
-  template <typename C1, typename C2, typename ... Components>
-  static void detachTreeComponentFromParent(Entity &entity);
+  static void detachTreeComponentsFromParent(Entity &entity);
 };
 
 #pragma mark - Treent Template Implementation
@@ -97,24 +245,77 @@ template <typename ... TreeComponents>
 TreentT<TreeComponents...>::TreentT(const Entity &entity)
 : TreentBase(entity)
 {
-  assignIfMissing<ChildrenComponent>();
+  setup();
+}
+
+template <typename ... TreeComponents>
+TreentT<TreeComponents...>::TreentT(EntityManager &entities, const Entity &entity)
+: TreentBase(entities, entity)
+{
+  setup();
+}
+
+template <typename ... TreeComponents>
+void TreentT<TreeComponents...>::setup()
+{
+  if (! hasComponent<ChildrenComponent>())
+  {
+    assert(_entities && "Treents need an EntityManager; pass one or call SharedEntities::instance().setup().");
+    assign<ChildrenComponent>(*_entities);
+  }
   assignIfMissing<TreeComponents...>();
+  if (_entities)
+  {
+    component<ChildrenComponent>()->setEntities(*_entities);
+    int trees[] = { 0, (bindOrder<TreeComponents>(), 0)... };
+    (void)trees;
+  }
+}
+
+template <typename ... TreeComponents>
+template <typename C>
+void TreentT<TreeComponents...>::bindOrder()
+{
+  auto c = component<C>();
+  if (! c->hasOrder())
+  {
+    c->setOrder(TreeOrder<C>::instance(*_entities), entity().id());
+  }
+}
+
+template <typename ... TreeComponents>
+template <typename C>
+TreeSpan<C> TreentT<TreeComponents...>::descendants() const
+{
+  auto node = entity();
+  auto &order = TreeOrder<C>::instance(entities());
+  order.update(entities());
+  return order.descendants(*node.template component<C>().get());
 }
 
 template <typename ... TreeComponents>
-void TreentT<TreeComponents...>::visit(const std::function<void (TreentT<TreeComponents...>)> &fn)
+template <typename F>
+void TreentT<TreeComponents...>::visit(F &&fn)
 {
   fn(*this);
   visitChildren(fn);
 }
 
 template <typename ... TreeComponents>
-void TreentT<TreeComponents...>::visitChildren(const std::function<void (TreentT<TreeComponents...>)> &fn)
+template <typename F>
+void TreentT<TreeComponents...>::visitChildren(F &&fn)
 {
-  for (const auto &child : getChildren())
+  detail::TraversalStack<Entity> stack;
+  const auto &children = getChildren();
+  stack.pushReversed(children.begin(), children.end());
+
+  while (! stack.empty())
   {
-    auto tc = TreentT(child);
-    tc.visit(fn);
+    // Attaching gave every child a ChildrenComponent, so skip the component checks.
+    auto node = TreentT(_entities, stack.pop(), Unchecked());
+    fn(node);
+    const auto &grandchildren = node.getChildren();
+    stack.pushReversed(grandchildren.begin(), grandchildren.end());
   }
 }
 
@@ -123,32 +324,95 @@ void TreentT<TreeComponents...>::attachChild(entityx::Entity &child)
 {
   auto pc = treent::getOrAssign<ParentComponent>(child);
   auto cc = component<ChildrenComponent>();
+  // Every linked entity can be walked, even one appended without being made a Treent.
+  if (! child.has_component<ChildrenComponent>())
+  {
+    child.assign<ChildrenComponent>(*_entities);
+  }
+  child.component<ChildrenComponent>()->setEntities(*_entities);
+  cc->setEntities(*_entities);
 
-  pc->_parent = entity();
-  cc->addChild(child);
+  pc->_parent = NodeHandle(entity());
+  pc->_index = cc->addChild(child);
 
-  attachChildTreeComponent<TreeComponents...>(child);
+  int trees[] = { 0, (attachChildTreeComponent<TreeComponents>(child), 0)... };
+  (void)trees;
 }
 
 template <typename ... TreeComponents>
 void TreentT<TreeComponents...>::detachFromParent(entityx::Entity &child)
+{
+  auto parent = unlink(child);
+  if (parent)
+  {
+    recordChange(TreeChange::Kind::Detached, child, parent);
+  }
+}
+
+template <typename ... TreeComponents>
+auto TreentT<TreeComponents...>::unlink(entityx::Entity &child) -> Entity
 {
   auto pc = child.component<ParentComponent>();
+  Entity parent;
 
   if (pc)
   {
-    pc->_parent.component<ChildrenComponent>()->removeChild(child);
+    parent = parentOf(child, *pc.get());
+    parent.component<ChildrenComponent>()->removeChild(child, pc->_index);
     pc.remove();
-    detachTreeComponentFromParent<TreeComponents...>(child);
+    detachTreeComponentsFromParent(child);
+  }
+  return parent;
+}
+
+template <typename ... TreeComponents>
+auto TreentT<TreeComponents...>::parentOf(Entity &child, const ParentComponent &pc) -> Entity
+{
+  // Linking gave the child a ChildrenComponent that knows our manager.
+  return pc._parent.entity(*child.component<ChildrenComponent>()->entities());
+}
+
+template <typename ... TreeComponents>
+TreeChangeLog* TreentT<TreeComponents...>::changeLog(Entity &node)
+{
+  using First = typename std::tuple_element<0, std::tuple<TreeComponents...>>::type;
+  auto c = node.component<First>();
+  return c.valid() ? c->order().changes() : nullptr;
+}
+
+template <typename ... TreeComponents>
+void TreentT<TreeComponents...>::release(const EntityManager &entities)
+{
+  int orders[] = { 0, (TreeOrder<TreeComponents>::release(entities), 0)... };
+  (void)orders;
+  TreeChangeLog::release(entities);
+  detail::ManagerRegistry<detail::DestroyQueue>::release(entities);
+}
+
+template <typename ... TreeComponents>
+void TreentT<TreeComponents...>::recordChange(TreeChange::Kind kind, Entity &root, const Entity &parent)
+{
+  auto log = changeLog(root);
+  if (log)
+  {
+    log->record(kind, root, parent);
   }
 }
 
+template <typename ... TreeComponents>
+void TreentT<TreeComponents...>::safeDestroy(Entity &entity)
+{
+  auto parent = unlink(entity);
+  recordChange(TreeChange::Kind::Destroyed, entity, parent);
+  entity.destroy();
+}
+
 template <typename ... TreeComponents>
 void TreentT<TreeComponents...>::removeChild(entityx::Entity &child)
 {
   auto pc = child.component<ParentComponent>();
 
-  if (pc && pc->_parent == entity())
+  if (pc && pc->_parent.refersTo(entity().id()))
   {
     detachFromParent(child);
   }
@@ -161,8 +425,11 @@ void TreentT<TreeComponents...>::removeChild(entityx::Entity &child)
 template <typename ... TreeComponents>
 TreentT<TreeComponents...> TreentT<TreeComponents...>::createChild()
 {
-  auto child = TreentT(entities().create());
+  // Unbound components join our orders as they are attached, so skip looking them up.
+  auto child = TreentT(_entities, entities().create(), Unchecked());
+  child.template assignIfMissing<TreeComponents...>();
   attachChild(child.entity());
+  recordChange(TreeChange::Kind::Attached, child.entity(), entity());
   return child;
 }
 
@@ -170,8 +437,11 @@ template <typename ... TreeComponents>
 template <typename Derived, typename ... Parameters>
 Derived TreentT<TreeComponents...>::createChild(Parameters&& ... parameters)
 {
+  // Route the Derived constructor, and any children it creates, to our manager.
+  SharedEntities::Scope scope(entities());
   auto child = Derived(entities().create(), std::forward<Parameters>(parameters)...);
   attachChild(child.entity());
+  recordChange(TreeChange::Kind::Attached, child.entity(), entity());
   return child;
 }
 
@@ -180,53 +450,366 @@ void TreentT<TreeComponents...>::appendChild(Entity &child)
 {
   detachFromParent(child);
   attachChild(child);
+  recordChange(TreeChange::Kind::Attached, child, entity());
+}
+
+template <typename ... TreeComponents>
+template <typename ... Components>
+std::vector<TreentT<TreeComponents...>> TreentT<TreeComponents...>::instantiate(const TreentT &prototype, size_t count)
+{
+  auto flat = flatten(prototype);
+  std::vector<Entity> clones(flat.nodes.size());
+  std::vector<TreentT> roots;
+  roots.reserve(count);
+
+  reserveChildren(getChildren().size() + count);
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    auto root = cloneFlattened<Components...>(entities(), flat, clones);
+    attachChild(root.entity());
+    recordChange(TreeChange::Kind::Attached, root.entity(), entity());
+    roots.push_back(root);
+  }
+  return roots;
+}
+
+template <typename ... TreeComponents>
+template <typename ... Components>
+TreentT<TreeComponents...> TreentT<TreeComponents...>::cloneSubtree(EntityManager &entities, const TreentT &prototype)
+{
+  auto flat = flatten(prototype);
+  std::vector<Entity> clones(flat.nodes.size());
+  return cloneFlattened<Components...>(entities, flat, clones);
+}
+
+template <typename ... TreeComponents>
+auto TreentT<TreeComponents...>::flatten(const TreentT &root) -> Prototype
+{
+  Prototype flat;
+  detail::TraversalStack<std::pair<Entity, uint32_t>> stack;
+  stack.push(std::make_pair(root.entity(), UINT32_MAX));
+
+  while (! stack.empty())
+  {
+    auto item = stack.pop();
+    auto index = static_cast<uint32_t>(flat.nodes.size());
+    const auto children = item.first.template component<ChildrenComponent>()->children();
+
+    flat.nodes.push_back(item.first);
+    flat.parents.push_back(item.second);
+    flat.childCounts.push_back(static_cast<uint32_t>(children.size()));
+    for (auto it = children.rbegin(); it != children.rend(); ++it)
+    {
+      stack.push(std::make_pair(*it, index));
+    }
+  }
+  return flat;
+}
+
+template <typename ... TreeComponents>
+template <typename ... Components>
+TreentT<TreeComponents...> TreentT<TreeComponents...>::cloneFlattened(EntityManager &entities, Prototype &prototype, std::vector<Entity> &clones)
+{
+  auto &sources = prototype.nodes;
+  buildFlattened(entities, prototype.parents.data(), prototype.childCounts.data(), 0, sources.size(), clones, [&sources] (size_t i, Entity &clone, size_t childCount) {
+    int trees[] = { 0, (cloneTreeComponent<TreeComponents>(sources[i], clone, childCount), 0)... };
+    int extras[] = { 0, (cloneComponent<Components>(sources[i], clone), 0)... };
+    (void)trees;
+    (void)extras;
+  });
+  return TreentT(&entities, clones[0], Unchecked());
+}
+
+template <typename ... TreeComponents>
+template <typename Assign>
+void TreentT<TreeComponents...>::buildFlattened(EntityManager &entities, const uint32_t *parents, const uint32_t *childCounts, size_t begin, size_t end, std::vector<Entity> &nodes, Assign &&assign)
+{
+  nodes.resize(std::max(nodes.size(), end));
+  for (size_t i = begin; i < end; ++i)
+  {
+    auto &node = nodes[i];
+    const auto childCount = childCounts[i];
+
+    node = entities.create();
+    node.assign<ChildrenComponent>(entities)->reserve(childCount);
+    assign(i, node, childCount);
+
+    // Parents come first, so they are fully set up before we link to them.
+    // Descendants join the root's orders as they are attached.
+    if (i > 0)
+    {
+      TreentT(&entities, nodes[parents[i]], Unchecked()).attachChild(node);
+    }
+    else
+    {
+      auto root = TreentT(&entities, node, Unchecked());
+      int orders[] = { 0, (root.template bindOrder<TreeComponents>(), 0)... };
+      (void)orders;
+    }
+  }
+}
+
+template <typename ... TreeComponents>
+template <typename C>
+void TreentT<TreeComponents...>::cloneTreeComponent(Entity &source, Entity &clone, size_t childCount)
+{
+  auto c = clone.assign<C>();
+  c->setLocal(source.component<C>()->local());
+  c->reserveChildren(childCount);
+}
+
+template <typename ... TreeComponents>
+template <typename C>
+void TreentT<TreeComponents...>::cloneComponent(Entity &source, Entity &clone)
+{
+  if (source.has_component<C>())
+  {
+    clone.assign<C>(*source.component<C>().get());
+  }
+}
+
+template <typename ... TreeComponents>
+void TreentT<TreeComponents...>::reserveChildren(size_t count)
+{
+  component<ChildrenComponent>()->reserve(count);
+  int trees[] = { 0, (component<TreeComponents>()->reserveChildren(count), 0)... };
+  (void)trees;
+}
+
+template <typename ... TreeComponents>
+void TreentT<TreeComponents...>::shrinkChildren()
+{
+  component<ChildrenComponent>()->shrink();
+  int trees[] = { 0, (component<TreeComponents>()->shrinkChildren(), 0)... };
+  (void)trees;
 }
 
 template <typename ... TreeComponents>
 void TreentT<TreeComponents...>::destroyChildren()
 {
-  auto cc = component<ChildrenComponent>();
-  auto children = cc->_children;
-  cc->_children.clear();
+  TREENT_STAT_TIMER(destructionNanoseconds);
+  detail::ScratchVector<Entity> scratch;
+  auto &nodes = scratch.items();
+  nodes.push_back(entity());
+  collectDescendants(nodes);
+  // Our children come first in the collected list, right after us.
+  auto log = changeLog(entity());
+  for (size_t i = 1; log && log->recording() && i < nodes.size() && nodes[i].template component<ParentComponent>()->_parent.refersTo(entity().id()); ++i)
+  {
+    log->record(TreeChange::Kind::Destroyed, nodes[i], entity());
+  }
+  destroyCollected(nodes, 1);
+}
+
+template <typename ... TreeComponents>
+void TreentT<TreeComponents...>::destroySubtree(Entity &root)
+{
+  if (! root.valid())
+  {
+    return;
+  }
+
+  TREENT_STAT_TIMER(destructionNanoseconds);
+  auto parent = unlink(root);
+  recordChange(TreeChange::Kind::Destroyed, root, parent);
+  detail::ScratchVector<Entity> scratch;
+  auto &nodes = scratch.items();
+  nodes.push_back(root);
+  collectDescendants(nodes);
+  destroyCollected(nodes, 0);
+}
+
+template <typename ... TreeComponents>
+void TreentT<TreeComponents...>::flushDestroyed(EntityManager &entities)
+{
+  auto &queue = destroyQueue(entities);
+  std::vector<Entity> nodes;
+  nodes.swap(queue);
+  destroySubtrees(nodes);
+
+  // Hand the storage back for the next frame.
+  if (queue.empty())
+  {
+    queue.swap(nodes);
+  }
+}
+
+template <typename ... TreeComponents>
+void TreentT<TreeComponents...>::destroySubtrees(std::vector<Entity> &nodes)
+{
+  TREENT_STAT_TIMER(destructionNanoseconds);
+  // Skip roots that were destroyed already, and roots listed more than once.
+  auto destroyed = [] (const Entity &e) { return ! e.valid(); };
+  nodes.erase(std::remove_if(nodes.begin(), nodes.end(), destroyed), nodes.end());
+  std::sort(nodes.begin(), nodes.end(), [] (const Entity &a, const Entity &b) { return a.id() < b.id(); });
+  nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+
+  // Detaching every root first means a root listed along with one of its ancestors
+  // is no longer reachable from that ancestor, so nothing is collected twice.
+  for (auto &root : nodes)
+  {
+    auto parent = unlink(root);
+    recordChange(TreeChange::Kind::Destroyed, root, parent);
+  }
 
-	for (auto &child : children)
+  // Tear the subtrees down one at a time through a shared scratch list, so each one is
+  // still in cache between collecting and destroying it.
+  detail::ScratchVector<Entity> scratch;
+  auto &subtree = scratch.items();
+  for (auto &root : nodes)
   {
-    detachTreeComponentFromParent<TreeComponents...>(child);
-    child.destroy();
-	}
+    subtree.assign(1, root);
+    collectDescendants(subtree);
+    destroyCollected(subtree, 0);
+  }
+  nodes.clear();
+}
+
+template <typename ... TreeComponents>
+void TreentT<TreeComponents...>::collectDescendants(std::vector<Entity> &nodes)
+{
+  for (size_t i = 0; i < nodes.size(); ++i)
+  {
+    auto cc = nodes[i].component<ChildrenComponent>();
+    if (cc)
+    {
+      for (auto child : cc->children())
+      {
+        if (child)
+        {
+          nodes.push_back(child);
+        }
+      }
+    }
+  }
+}
+
+template <typename ... TreeComponents>
+void TreentT<TreeComponents...>::destroyCollected(std::vector<Entity> &nodes, size_t first)
+{
+  // With every child list empty, no destructor below cascades or unlinks anything.
+  for (auto &node : nodes)
+  {
+    auto cc = node.component<ChildrenComponent>();
+    if (cc)
+    {
+      cc->clear();
+    }
+    int trees[] = { 0, (releaseTreeComponentChildren<TreeComponents>(node), 0)... };
+    (void)trees;
+  }
+
+  for (size_t i = nodes.size(); i > first; --i)
+  {
+    nodes[i - 1].destroy();
+  }
+  TREENT_STAT_ADD(destroyed, nodes.size() - first);
 }
 
 template <typename ... TreeComponents>
 template <typename C>
-void TreentT<TreeComponents...>::attachChildTreeComponent(Entity &child)
+void TreentT<TreeComponents...>::releaseTreeComponentChildren(Entity &entity)
 {
-  C::attachToParent(child.component<C>(), component<C>());
+  auto c = entity.component<C>();
+  if (c)
+  {
+    c->releaseChildren();
+  }
 }
 
 template <typename ... TreeComponents>
-template <typename C1, typename C2, typename ... Components>
+template <typename C>
 void TreentT<TreeComponents...>::attachChildTreeComponent(Entity &child)
 {
-  attachChildTreeComponent<C1>(child);
-  return attachChildTreeComponent<C2, Components ...>(child);
+  // Entities appended without a component stay out of that component's tree.
+  auto c = child.component<C>();
+  if (c)
+  {
+    C::attachToParent(c, component<C>());
+  }
 }
 
 template <typename ... TreeComponents>
 template <typename C>
 void TreentT<TreeComponents...>::detachTreeComponentFromParent(Entity &child)
 {
-	auto c = child.component<C>();
-	if( c ) {
-		c->detachFromParent();
-	}
+  auto c = child.component<C>();
+  if (c)
+  {
+    c->detachFromParent();
+  }
 }
 
 template <typename ... TreeComponents>
-template <typename C1, typename C2, typename ... Components>
-void TreentT<TreeComponents...>::detachTreeComponentFromParent(Entity &child)
+void TreentT<TreeComponents...>::detachTreeComponentsFromParent(Entity &child)
 {
-  detachTreeComponentFromParent<C1>(child);
-  return detachTreeComponentFromParent<C2, Components ...>(child);
+  int trees[] = { 0, (detachTreeComponentFromParent<TreeComponents>(child), 0)... };
+  (void)trees;
+}
+
+///
+/// A lightweight, read-mostly view of a Treent node.
+/// Unlike TreentT, constructing a view never checks for or assigns components, so it
+/// costs no more than copying the entity. Use views to iterate over existing trees;
+/// the viewed entity must already have been set up as a TreentT.
+///
+template <typename ... TreeComponents>
+class TreentViewT : public TreentBase
+{
+public:
+  /// Constructs an invalid view.
+  TreentViewT() = default;
+  /// Constructs a view of an entity that is already a Treent.
+  explicit TreentViewT(const Entity &entity)
+  : TreentBase(entity)
+  {}
+  TreentViewT(EntityManager *entities, const Entity &entity)
+  : TreentBase(entities, entity)
+  {}
+
+  ChildrenComponent::ChildList getChildren() { return component<ChildrenComponent>()->children(); }
+  bool isRoot() const { return ! hasComponent<ParentComponent>(); }
+
+  /// Recursively visit this node and all of its descendants, passing each view to \a fn.
+  template <typename F>
+  void visit(F &&fn);
+  /// Recursively visit all of this node's descendants, passing each view to \a fn.
+  template <typename F>
+  void visitChildren(F &&fn);
+
+  /// Returns the full Treent interface to the viewed entity.
+  TreentT<TreeComponents...> treent() const { return TreentT<TreeComponents...>(_entities, entity(), typename TreentT<TreeComponents...>::Unchecked()); }
+
+  ChildrenComponent::ChildList::const_iterator begin() { return getChildren().begin(); }
+  ChildrenComponent::ChildList::const_iterator end() { return getChildren().end(); }
+};
+
+#pragma mark - TreentView Template Implementation
+
+template <typename ... TreeComponents>
+template <typename F>
+void TreentViewT<TreeComponents...>::visit(F &&fn)
+{
+  fn(*this);
+  visitChildren(fn);
+}
+
+template <typename ... TreeComponents>
+template <typename F>
+void TreentViewT<TreeComponents...>::visitChildren(F &&fn)
+{
+  detail::TraversalStack<Entity> stack;
+  const auto &children = getChildren();
+  stack.pushReversed(children.begin(), children.end());
+
+  while (! stack.empty())
+  {
+    auto node = TreentViewT(_entities, stack.pop());
+    fn(node);
+    const auto &grandchildren = node.getChildren();
+    stack.pushReversed(grandchildren.begin(), grandchildren.end());
+  }
 }
 
 } // namespace treent
@@ -36,15 +36,40 @@ using entityx::Entity;
 using entityx::EntityManager;
 using entityx::ComponentHandle;
 
+///
+/// The EntityManager used by Treents that aren't given one explicitly.
+/// A Scope overrides it for the current thread, which lets code that only knows about
+/// entities (like Treent subclass constructors) build into another manager:
+///
+/// SharedEntities::Scope scope(stagingEntities);
+/// auto prefab = Treent::create<MyPrefab>();
+///
 class SharedEntities
 {
 public:
   static SharedEntities& instance();
   void   setup(entityx::EntityManager &entities) { _entities = &entities; }
 
+  /// Routes Treents created without an explicit manager on this thread to \a entities
+  /// for the lifetime of the Scope. Scopes nest.
+  class Scope
+  {
+  public:
+    explicit Scope(entityx::EntityManager &entities)
+    : _previous(current())
+    { current() = &entities; }
+    ~Scope() { current() = _previous; }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+  private:
+    entityx::EntityManager *_previous;
+  };
+
 private:
   SharedEntities() = default;
-  entityx::EntityManager& entities() { return *_entities; }
+  entityx::EntityManager* entities() { auto scoped = current(); return scoped ? scoped : _entities; }
+  static entityx::EntityManager*& current() { static thread_local entityx::EntityManager *sCurrent = nullptr; return sCurrent; }
   entityx::EntityManager *_entities = nullptr;
 
   friend class TreentBase;
@@ -76,10 +101,10 @@ public:
   /// Constructs an invalid Treent.
   TreentBase() = default;
 
-  /// Constructs a Treent that provides a facade to an entity.
-  explicit TreentBase(const Entity &entity): _entity(entity) {}
-  /// In case you store a pointer/reference to base. (TODO: perf test this to see if it matters at all).
-  virtual ~TreentBase() = default;
+  /// Constructs a Treent that provides a facade to an entity of the shared EntityManager.
+  explicit TreentBase(const Entity &entity): _entity(entity), _entities(sharedEntities()) {}
+  /// Constructs a Treent that provides a facade to an entity of \a entities.
+  TreentBase(EntityManager &entities, const Entity &entity): _entity(entity), _entities(&entities) {}
 
   //
   // Mirror Entity methods. (add/remove components, getOrAssign convenience.)
@@ -88,6 +113,8 @@ public:
   /// Returns the underlying entity.
   Entity&             entity() { return _entity; }
 	const Entity&				entity() const { return _entity; }
+  /// Returns the EntityManager the entity belongs to. Children are created there too.
+  EntityManager&      entities() const { return *_entities; }
 
   /// Assign a component to entity, forwards params to the component constructor.
   template <typename C, typename ... Params>
@@ -130,8 +157,16 @@ public:
   void                destroy() { _entity.destroy(); }
 
 protected:
-  static EntityManager&   entities() { return SharedEntities::instance().entities(); }
+  /// Treents are handles copied and moved by value, so there is no vtable to pay for.
+  /// Protected, since deleting one through a TreentBase pointer would skip the derived part.
+  ~TreentBase() = default;
+
+  /// Wraps an entity of \a entities, which may be null.
+  TreentBase(EntityManager *entities, const Entity &entity): _entity(entity), _entities(entities) {}
+
+  static EntityManager*   sharedEntities() { return SharedEntities::instance().entities(); }
   entityx::Entity         _entity;
+  EntityManager          *_entities = nullptr;
 };
 
 #pragma mark - Template method implementation
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#pragma once
+
+#include "entityx/Entity.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace treent
+{
+namespace detail
+{
+
+///
+/// Keeps one T per EntityManager, made by a factory on first use and kept until release().
+/// Lookups check a per-thread cache of the last manager asked for first, so the mutex and
+/// the scan are only paid when a thread moves to another manager.
+///
+template <typename T>
+class ManagerRegistry
+{
+public:
+  using Factory = T* (*)(const entityx::EntityManager &entities);
+
+  /// The T of \a entities, made with \a create if there isn't one yet. Safe to call from any thread.
+  static T&     get(const entityx::EntityManager &entities, Factory create);
+  /// Destroy the T of \a entities, if any. Nothing may use it afterward.
+  static void   release(const entityx::EntityManager &entities);
+  /// Calls \a fn(T&) for every registered T, holding the registry lock.
+  template <typename F>
+  static void   each(F &&fn);
+
+private:
+  struct Registry
+  {
+    std::mutex                                                                mutex;
+    std::vector<std::pair<const entityx::EntityManager*, std::unique_ptr<T>>> entries;
+    /// Bumped by every release(), so no thread's cache outlives the T it points to.
+    std::atomic<uint32_t>                                                     epoch;
+  };
+  struct Cache
+  {
+    const entityx::EntityManager  *entities;
+    T                             *value;
+    uint32_t                      epoch;
+  };
+
+  static Registry& registry();
+  static Cache&    cache();
+};
+
+#pragma mark - ManagerRegistry Template Implementation
+
+template <typename T>
+T& ManagerRegistry<T>::get(const entityx::EntityManager &entities, Factory create)
+{
+  auto &reg = registry();
+  auto &last = cache();
+  const auto epoch = reg.epoch.load(std::memory_order_acquire);
+  if (last.entities == &entities && last.epoch == epoch)
+  {
+    return *last.value;
+  }
+
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  T *value = nullptr;
+  for (auto &entry : reg.entries)
+  {
+    if (entry.first == &entities)
+    {
+      value = entry.second.get();
+      break;
+    }
+  }
+  if (! value)
+  {
+    reg.entries.emplace_back(&entities, std::unique_ptr<T>(create(entities)));
+    value = reg.entries.back().second.get();
+  }
+  last.entities = &entities;
+  last.value = value;
+  last.epoch = reg.epoch.load(std::memory_order_relaxed);
+  return *value;
+}
+
+template <typename T>
+void ManagerRegistry<T>::release(const entityx::EntityManager &entities)
+{
+  auto &reg = registry();
+  std::unique_ptr<T> released;
+  {
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (auto it = reg.entries.begin(); it != reg.entries.end(); ++it)
+    {
+      if (it->first == &entities)
+      {
+        released = std::move(it->second);
+        reg.entries.erase(it);
+        reg.epoch.fetch_add(1, std::memory_order_release);
+        break;
+      }
+    }
+  }
+}
+
+template <typename T>
+template <typename F>
+void ManagerRegistry<T>::each(F &&fn)
+{
+  auto &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  for (auto &entry : reg.entries)
+  {
+    fn(*entry.second);
+  }
+}
+
+template <typename T>
+typename ManagerRegistry<T>::Registry& ManagerRegistry<T>::registry()
+{
+  static Registry sRegistry;
+  return sRegistry;
+}
+
+template <typename T>
+typename ManagerRegistry<T>::Cache& ManagerRegistry<T>::cache()
+{
+  static thread_local Cache sCache = { nullptr, nullptr, 0 };
+  return sCache;
+}
+
+} // namespace detail
+} // namespace treent
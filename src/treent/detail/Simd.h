@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+#if defined(TREENT_NO_SIMD)
+  // Scalar kernels only.
+#elif defined(__AVX__)
+  #include <immintrin.h>
+  #define TREENT_SIMD_AVX 1
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+  #include <xmmintrin.h>
+  #define TREENT_SIMD_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  #include <arm_neon.h>
+  #define TREENT_SIMD_NEON 1
+#endif
+
+namespace treent
+{
+namespace detail
+{
+namespace simd
+{
+
+///
+/// Element-wise kernels over float lanes, used by batch composition.
+/// Arrays need not be aligned. Define TREENT_NO_SIMD to force the scalar versions.
+///
+
+/// out[i] = a[i] + b[i]
+inline void add(float *out, const float *a, const float *b, size_t count)
+{
+  size_t i = 0;
+#if TREENT_SIMD_AVX
+  for (; i + 8 <= count; i += 8)
+  {
+    _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+  }
+#elif TREENT_SIMD_SSE
+  for (; i + 4 <= count; i += 4)
+  {
+    _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+#elif TREENT_SIMD_NEON
+  for (; i + 4 <= count; i += 4)
+  {
+    vst1q_f32(out + i, vaddq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+  }
+#endif
+  for (; i < count; ++i)
+  {
+    out[i] = a[i] + b[i];
+  }
+}
+
+/// out[i] = a[i] * b[i]
+inline void multiply(float *out, const float *a, const float *b, size_t count)
+{
+  size_t i = 0;
+#if TREENT_SIMD_AVX
+  for (; i + 8 <= count; i += 8)
+  {
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+  }
+#elif TREENT_SIMD_SSE
+  for (; i + 4 <= count; i += 4)
+  {
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+#elif TREENT_SIMD_NEON
+  for (; i + 4 <= count; i += 4)
+  {
+    vst1q_f32(out + i, vmulq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+  }
+#endif
+  for (; i < count; ++i)
+  {
+    out[i] = a[i] * b[i];
+  }
+}
+
+/// out[i] = offset[i] + a[0][i] * b[0][i] + ... + a[terms - 1][i] * b[terms - 1][i]
+/// \a offset may be null. Used for matrix products laid out one lane per element.
+inline void sumOfProducts(float *out, const float *const *a, const float *const *b, size_t terms, const float *offset, size_t count)
+{
+  size_t i = 0;
+#if TREENT_SIMD_AVX
+  for (; i + 8 <= count; i += 8)
+  {
+    auto sum = offset ? _mm256_loadu_ps(offset + i) : _mm256_setzero_ps();
+    for (size_t t = 0; t < terms; ++t)
+    {
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a[t] + i), _mm256_loadu_ps(b[t] + i)));
+    }
+    _mm256_storeu_ps(out + i, sum);
+  }
+#elif TREENT_SIMD_SSE
+  for (; i + 4 <= count; i += 4)
+  {
+    auto sum = offset ? _mm_loadu_ps(offset + i) : _mm_setzero_ps();
+    for (size_t t = 0; t < terms; ++t)
+    {
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a[t] + i), _mm_loadu_ps(b[t] + i)));
+    }
+    _mm_storeu_ps(out + i, sum);
+  }
+#elif TREENT_SIMD_NEON
+  for (; i + 4 <= count; i += 4)
+  {
+    auto sum = offset ? vld1q_f32(offset + i) : vdupq_n_f32(0.0f);
+    for (size_t t = 0; t < terms; ++t)
+    {
+      sum = vmlaq_f32(sum, vld1q_f32(a[t] + i), vld1q_f32(b[t] + i));
+    }
+    vst1q_f32(out + i, sum);
+  }
+#endif
+  for (; i < count; ++i)
+  {
+    float sum = offset ? offset[i] : 0.0f;
+    for (size_t t = 0; t < terms; ++t)
+    {
+      sum += a[t][i] * b[t][i];
+    }
+    out[i] = sum;
+  }
+}
+
+/// out[i] = a[i]
+inline void copy(float *out, const float *a, size_t count)
+{
+  std::memcpy(out, a, count * sizeof(float));
+}
+
+} // namespace simd
+} // namespace detail
+} // namespace treent
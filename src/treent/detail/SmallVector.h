@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "treent/TreeArena.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace treent
+{
+namespace detail
+{
+
+///
+/// A vector that stores up to N elements inline before moving them to the heap.
+/// Used for child lists, where most nodes have a handful of children; those nodes then
+/// need no allocation beyond the component pool that holds them. Larger lists come from
+/// the current thread's TreeArena, if it has one.
+/// Supports the subset of std::vector's interface that Treent uses.
+///
+template <typename T, size_t N>
+class SmallVector
+{
+  static_assert(N > 0, "SmallVector needs room for at least one inline element.");
+public:
+  using value_type = T;
+  using size_type = size_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using iterator = T*;
+  using const_iterator = const T*;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  SmallVector()
+  : _data(inlineData())
+  {}
+
+  SmallVector(const SmallVector &other);
+  SmallVector(SmallVector &&other);
+  ~SmallVector();
+
+  SmallVector& operator= (const SmallVector &rhs);
+  SmallVector& operator= (SmallVector &&rhs);
+
+  iterator                begin() { return _data; }
+  iterator                end() { return _data + _size; }
+  const_iterator          begin() const { return _data; }
+  const_iterator          end() const { return _data + _size; }
+  reverse_iterator        rbegin() { return reverse_iterator(end()); }
+  reverse_iterator        rend() { return reverse_iterator(begin()); }
+  const_reverse_iterator  rbegin() const { return const_reverse_iterator(end()); }
+  const_reverse_iterator  rend() const { return const_reverse_iterator(begin()); }
+
+  size_t    size() const { return _size; }
+  size_t    capacity() const { return _capacity; }
+  bool      empty() const { return _size == 0; }
+  /// True while the elements fit in the inline buffer.
+  bool      isInline() const { return _data == inlineData(); }
+
+  T*        data() { return _data; }
+  const T*  data() const { return _data; }
+  T&        operator[] (size_t i) { return _data[i]; }
+  const T&  operator[] (size_t i) const { return _data[i]; }
+  T&        front() { return _data[0]; }
+  T&        back() { return _data[_size - 1]; }
+  const T&  back() const { return _data[_size - 1]; }
+
+  void      reserve(size_t capacity) { if (capacity > _capacity) { reallocate(capacity); } }
+  /// Return heap storage if the elements fit inline again, else trim it to size.
+  void      shrink_to_fit();
+  void      clear();
+
+  void      push_back(const T &value);
+  void      push_back(T &&value);
+  template <typename ... Args>
+  void      emplace_back(Args&& ... args);
+  void      pop_back() { _data[--_size].~T(); }
+  iterator  erase(iterator first, iterator last);
+  iterator  erase(iterator position) { return erase(position, position + 1); }
+
+private:
+  T*        inlineData() { return reinterpret_cast<T*>(&_storage); }
+  const T*  inlineData() const { return reinterpret_cast<const T*>(&_storage); }
+  void      grow() { reallocate(_capacity * 2); }
+  void      reallocate(size_t capacity);
+  void      release();
+
+  typename std::aligned_storage<sizeof(T) * N, std::alignment_of<T>::value>::type _storage;
+  T        *_data;
+  uint32_t  _size = 0;
+  uint32_t  _capacity = N;
+};
+
+#pragma mark - SmallVector Template Implementation
+
+template <typename T, size_t N>
+SmallVector<T, N>::SmallVector(const SmallVector &other)
+: _data(inlineData())
+{
+  reserve(other._size);
+  for (const auto &value : other)
+  {
+    new (_data + _size) T(value);
+    _size += 1;
+  }
+}
+
+template <typename T, size_t N>
+SmallVector<T, N>::SmallVector(SmallVector &&other)
+: _data(inlineData())
+{
+  *this = std::move(other);
+}
+
+template <typename T, size_t N>
+SmallVector<T, N>::~SmallVector()
+{
+  release();
+}
+
+template <typename T, size_t N>
+SmallVector<T, N>& SmallVector<T, N>::operator= (const SmallVector &rhs)
+{
+  if (this != &rhs)
+  {
+    clear();
+    reserve(rhs._size);
+    for (const auto &value : rhs)
+    {
+      new (_data + _size) T(value);
+      _size += 1;
+    }
+  }
+  return *this;
+}
+
+template <typename T, size_t N>
+SmallVector<T, N>& SmallVector<T, N>::operator= (SmallVector &&rhs)
+{
+  if (this == &rhs)
+  {
+    return *this;
+  }
+
+  release();
+  if (rhs.isInline())
+  {
+    _data = inlineData();
+    _capacity = N;
+    for (auto &value : rhs)
+    {
+      new (_data + _size) T(std::move(value));
+      _size += 1;
+    }
+    rhs.clear();
+  }
+  else
+  {
+    // Take over the heap buffer.
+    _data = rhs._data;
+    _size = rhs._size;
+    _capacity = rhs._capacity;
+    rhs._data = rhs.inlineData();
+    rhs._size = 0;
+    rhs._capacity = N;
+  }
+  return *this;
+}
+
+template <typename T, size_t N>
+void SmallVector<T, N>::clear()
+{
+  for (auto &value : *this)
+  {
+    value.~T();
+  }
+  _size = 0;
+}
+
+template <typename T, size_t N>
+void SmallVector<T, N>::release()
+{
+  clear();
+  if (! isInline())
+  {
+    TreeArena::deallocate(_data);
+  }
+  _data = inlineData();
+  _capacity = N;
+}
+
+template <typename T, size_t N>
+void SmallVector<T, N>::reallocate(size_t capacity)
+{
+  auto data = (capacity <= N) ? inlineData() : static_cast<T*>(TreeArena::allocate(capacity * sizeof(T)));
+  if (data == _data)
+  {
+    return;
+  }
+
+  for (uint32_t i = 0; i < _size; ++i)
+  {
+    new (data + i) T(std::move(_data[i]));
+    _data[i].~T();
+  }
+  if (! isInline())
+  {
+    TreeArena::deallocate(_data);
+  }
+  _data = data;
+  _capacity = static_cast<uint32_t>((capacity <= N) ? N : capacity);
+}
+
+template <typename T, size_t N>
+void SmallVector<T, N>::shrink_to_fit()
+{
+  if (! isInline() && _size < _capacity)
+  {
+    reallocate(_size);
+  }
+}
+
+template <typename T, size_t N>
+void SmallVector<T, N>::push_back(const T &value)
+{
+  if (_size == _capacity)
+  {
+    // Copy first, since value may live in the buffer we are about to move.
+    T copy(value);
+    grow();
+    new (_data + _size) T(std::move(copy));
+  }
+  else
+  {
+    new (_data + _size) T(value);
+  }
+  _size += 1;
+}
+
+template <typename T, size_t N>
+void SmallVector<T, N>::push_back(T &&value)
+{
+  emplace_back(std::move(value));
+}
+
+template <typename T, size_t N>
+template <typename ... Args>
+void SmallVector<T, N>::emplace_back(Args&& ... args)
+{
+  if (_size == _capacity)
+  {
+    T value(std::forward<Args>(args)...);
+    grow();
+    new (_data + _size) T(std::move(value));
+  }
+  else
+  {
+    new (_data + _size) T(std::forward<Args>(args)...);
+  }
+  _size += 1;
+}
+
+template <typename T, size_t N>
+auto SmallVector<T, N>::erase(iterator first, iterator last) -> iterator
+{
+  auto end = std::move(last, this->end(), first);
+  for (auto it = end; it != this->end(); ++it)
+  {
+    it->~T();
+  }
+  _size -= static_cast<uint32_t>(last - first);
+  return first;
+}
+
+} // namespace detail
+} // namespace treent
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <utility>
+#include <vector>
+
+/// Initial capacity of the scratch stacks used by iterative tree traversal.
+/// Deep hierarchies grow their stacks once; after that, traversal doesn't allocate.
+#ifndef TREENT_TRAVERSAL_STACK_CAPACITY
+  #define TREENT_TRAVERSAL_STACK_CAPACITY 256
+#endif
+
+namespace treent
+{
+namespace detail
+{
+
+///
+/// A scratch vector borrowed from a per-thread cache.
+/// Vectors keep their capacity when returned, so steady-state passes that collect nodes
+/// into a list don't allocate. Each live ScratchVector owns its storage, which keeps nested
+/// passes from clobbering each other.
+///
+template <typename T>
+class ScratchVector
+{
+public:
+  ScratchVector();
+  ~ScratchVector();
+
+  ScratchVector(const ScratchVector &other) = delete;
+  ScratchVector& operator= (const ScratchVector &rhs) = delete;
+
+  /// The borrowed vector, empty when first borrowed.
+  std::vector<T>&       items() { return _items; }
+  const std::vector<T>& items() const { return _items; }
+
+private:
+  static std::vector<std::vector<T>>& cache();
+  std::vector<T> _items;
+};
+
+///
+/// A scratch stack for iterative traversal, backed by a ScratchVector, so steady-state
+/// traversal doesn't allocate and nested traversals (e.g. a visit callback that itself
+/// visits a tree) each get their own stack.
+///
+template <typename T>
+class TraversalStack
+{
+public:
+  void  push(const T &item) { _scratch.items().push_back(item); }
+  T     pop() { auto &items = _scratch.items(); T item = items.back(); items.pop_back(); return item; }
+  bool  empty() const { return _scratch.items().empty(); }
+
+  /// Push the items of [begin, end) so they pop in their original order.
+  template <typename I>
+  void  pushReversed(I begin, I end);
+
+private:
+  ScratchVector<T> _scratch;
+};
+
+#pragma mark - TraversalStack Template Implementation
+
+template <typename T>
+std::vector<std::vector<T>>& ScratchVector<T>::cache()
+{
+  static thread_local std::vector<std::vector<T>> sCache;
+  return sCache;
+}
+
+template <typename T>
+ScratchVector<T>::ScratchVector()
+{
+  auto &vectors = cache();
+  if (! vectors.empty())
+  {
+    _items.swap(vectors.back());
+    vectors.pop_back();
+  }
+  else
+  {
+    _items.reserve(TREENT_TRAVERSAL_STACK_CAPACITY);
+  }
+}
+
+template <typename T>
+ScratchVector<T>::~ScratchVector()
+{
+  _items.clear();
+  cache().push_back(std::move(_items));
+}
+
+template <typename T>
+template <typename I>
+void TraversalStack<T>::pushReversed(I begin, I end)
+{
+  auto &items = _scratch.items();
+  while (end != begin)
+  {
+    --end;
+    items.push_back(*end);
+  }
+}
+
+} // namespace detail
+} // namespace treent
@@ -52,6 +52,50 @@ void Treent2dApp::setup()
   }
   assert(e.valid() == false);
 
+  treent::Entity child;
+  {
+    treent::ScopedTreentGroup group;
+    auto a = group.create(entities);
+    child = a.createChild().entity();
+    group.add(ScopedTreent(entities.create()));
+    assert(group.size() == 2);
+    assert(child.valid());
+  }
+  assert(child.valid() == false);
+
+  // Snapshots round-trip topology and local values, and reject corrupt child counts.
+  {
+    auto root = treent::Treent::create(entities);
+    auto a = root.createChild();
+    auto b = root.createChild();
+    a.createChild().component<treent::TransformComponent>()->setLocal(treent::Transform(vec2(3, 4), 0.5f));
+    b.component<treent::StyleComponent>()->setLocal(treent::Style(0.25f, vec3(1, 0, 0)));
+
+    const auto bytes = treent::TreeSnapshot::save(root);
+    assert(treent::TreeSnapshot::valid(bytes.data(), bytes.size()));
+    auto copy = treent::TreeSnapshot::load(entities, bytes.data(), bytes.size());
+    assert(copy.valid());
+    assert(copy.getChildren().size() == 2);
+
+    auto copyA = treent::Treent(entities, copy.getChildren()[0]);
+    auto copyB = treent::Treent(entities, copy.getChildren()[1]);
+    assert(copyA.getChildren().size() == 1);
+    assert(copyB.getChildren().size() == 0);
+    auto grandchild = treent::Treent(entities, copyA.getChildren()[0]).component<treent::TransformComponent>()->local();
+    assert(grandchild.position == vec2(3, 4) && grandchild.rotation == 0.5f);
+    assert(copyB.component<treent::StyleComponent>()->local().alpha == 0.25f);
+
+    // The child counts follow the header, the local sizes and the parent indices.
+    auto corrupt = bytes;
+    const auto nodes = treent::TreeSnapshot::nodeCount(bytes.data(), bytes.size());
+    const auto childCounts = corrupt.size() - nodes * (sizeof(treent::Transform) + sizeof(treent::Style)) - nodes * sizeof(uint32_t);
+    corrupt[childCounts] = 0xff;
+    assert(! treent::TreeSnapshot::valid(corrupt.data(), corrupt.size()));
+    assert(! treent::TreeSnapshot::load(entities, corrupt.data(), corrupt.size()).valid());
+
+    root.destroySubtree();
+    copy.destroySubtree();
+  }
 }
 
 void Treent2dApp::mouseDown( MouseEvent event )
@@ -0,0 +1,759 @@
+/*
+ * Copyright (c) 2015 David Wicks, sansumbrella.com
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following
+ * conditions are met:
+ *
+ * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Headless benchmarks for Treent hierarchy operations.
+// Needs only EntityX and the Treent headers; no Cinder or app window.
+//
+// From the repository root:
+//   c++ -std=c++11 -O2 -DNDEBUG -Isrc -Ilib/entityx -o TreentBench tests/TreentBench/src/TreentBench.cpp
+//       lib/entityx/entityx/Entity.cc lib/entityx/entityx/Event.cc lib/entityx/entityx/help/Pool.cc -lpthread
+//   ./TreentBench [max nodes]
+//
+// Times each operation over deep chains, wide fans, balanced and random trees from 1k nodes
+// up to max nodes (1M by default). Passes over the whole tree report time and heap allocations
+// per node; queries and edits report them per call, timing an evenly spread sample of at most
+// SampleSize nodes so that linear-time operations stay measurable on large trees.
+// Scoped ownership is timed next, on forests of ten-node trees, and child lists served from
+// the heap versus a TreeArena next, and eager versus lazy evaluation under sparse reads last.
+//
+// The 2d and 3d reference components need Cinder's math types. Add Cinder's include path
+// and -DTREENT_BENCH_REFERENCE to also time 100k-node forests of Affine2d and Affine3d, and
+// descendLevels() against descendAll() on wide, shallow Transform and Style forests. The
+// latter fails the run unless both passes produce identical world values.
+//
+
+#include "entityx/Entity.h"
+#include "treent/Treent.h"
+#include "treent/TreeComponent.h"
+#include "treent/ScopedTreent.h"
+#include "treent/TreeArena.h"
+#include "treent/TreeView.h"
+
+#ifdef TREENT_BENCH_REFERENCE
+  #include "cinder/Vector.h"
+  #include "cinder/Quaternion.h"
+  #include "treent/2d/Components.h"
+  #include "treent/3d/Components.h"
+  #include <cmath>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#pragma mark - Allocation Counting
+
+namespace
+{
+  std::atomic<size_t> sAllocations(0);
+}
+
+void* operator new(size_t size)
+{
+  sAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto p = std::malloc(size ? size : 1))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) throw() { std::free(p); }
+void operator delete[](void *p) throw() { std::free(p); }
+void operator delete(void *p, size_t) throw() { std::free(p); }
+void operator delete[](void *p, size_t) throw() { std::free(p); }
+
+#pragma mark - Components
+
+///
+/// Minimal tree components, so the benchmarks don't depend on Cinder's math types.
+///
+struct OffsetComponent : public treent::TreeComponent<OffsetComponent, float>
+{
+  OffsetComponent() = default;
+  static float compose(const float &parent, const float &local) { return parent + local; }
+};
+
+struct OpacityComponent : public treent::TreeComponent<OpacityComponent, float>
+{
+  OpacityComponent() = default;
+  static float compose(const float &parent, const float &local) { return parent * local; }
+};
+
+/// Same composition as OffsetComponent, resolved and remembered on read.
+struct LazyOffsetComponent : public treent::TreeComponent<LazyOffsetComponent, float, float, treent::VectorLinks, treent::Evaluation::Lazy>
+{
+  LazyOffsetComponent() = default;
+  static float compose(const float &parent, const float &local) { return parent + local; }
+};
+
+using BenchTreent = treent::TreentT<OffsetComponent, OpacityComponent>;
+using ScopedBenchTreent = treent::ScopedTreentT<OffsetComponent, OpacityComponent>;
+using BenchTreentGroup = treent::ScopedTreentGroupT<OffsetComponent, OpacityComponent>;
+
+#pragma mark - Tree Shapes
+
+enum class Shape
+{
+  Chain,    // every node is the child of the one before it
+  Fan,      // every node is a child of the root
+  Balanced, // four children per node, filled breadth-first
+  Random    // every node is the child of a random earlier node
+};
+
+const char* shapeName(Shape shape)
+{
+  switch (shape)
+  {
+    case Shape::Chain: return "chain";
+    case Shape::Fan: return "fan";
+    case Shape::Balanced: return "balanced";
+    case Shape::Random: return "random";
+  }
+  return "";
+}
+
+/// Parent index of every node but the root, which is node 0.
+std::vector<size_t> makeParents(Shape shape, size_t count)
+{
+  std::mt19937 rng(count);
+  std::vector<size_t> parents(count, 0);
+  for (size_t i = 1; i < count; ++i)
+  {
+    switch (shape)
+    {
+      case Shape::Chain: parents[i] = i - 1; break;
+      case Shape::Fan: parents[i] = 0; break;
+      case Shape::Balanced: parents[i] = (i - 1) / 4; break;
+      case Shape::Random: parents[i] = rng() % i; break;
+    }
+  }
+  return parents;
+}
+
+#pragma mark - Measurement
+
+/// Most nodes timed by the per-call benchmarks.
+const size_t SampleSize = 1000;
+
+///
+/// Times a block of work on a tree of \a nodes nodes and prints one result line.
+/// \a operations is the number of nodes processed or calls made by the work.
+///
+class Measurement
+{
+public:
+  Measurement(const char *label, size_t nodes, const char *operation, size_t operations)
+  : _label(label),
+    _nodes(nodes),
+    _operations(operations),
+    _operation(operation),
+    _allocations(sAllocations.load()),
+    _start(Clock::now())
+  {}
+
+  ~Measurement()
+  {
+    const auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - _start).count();
+    const auto allocations = sAllocations.load() - _allocations;
+    const auto count = static_cast<double>(_operations * _repetitions);
+    std::printf("%-9s %8zu  %-22s %8zu %10.3f %10.1f %9.2f\n", _label, _nodes, _operation, _operations, elapsed / 1.0e6 / _repetitions, elapsed / count, allocations / count);
+  }
+
+  /// Number of times the work is repeated, so results are reported per repetition.
+  void setRepetitions(size_t repetitions) { _repetitions = repetitions; }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  const char       *_label;
+  size_t            _nodes;
+  size_t            _operations;
+  const char       *_operation;
+  size_t            _allocations;
+  size_t            _repetitions = 1;
+  Clock::time_point _start;
+};
+
+/// Repeat cheap passes over small trees enough to get a stable reading.
+size_t repetitionsFor(size_t nodes) { return std::max<size_t>(1, 1000000 / nodes); }
+
+#pragma mark - Benchmarks
+
+void benchmark(Shape shape, size_t count)
+{
+  entityx::EventManager events;
+  entityx::EntityManager entities(events);
+
+  const auto parents = makeParents(shape, count);
+  std::vector<BenchTreent> nodes;
+  nodes.reserve(count);
+
+  // Evenly spread non-root nodes for the per-call benchmarks.
+  std::vector<size_t> sample;
+  const auto stride = std::max<size_t>(1, (count - 1) / SampleSize);
+  for (size_t i = 1; i < count && sample.size() < SampleSize; i += stride)
+  {
+    sample.push_back(i);
+  }
+
+  {
+    Measurement m(shapeName(shape), count, "create", count);
+    nodes.push_back(BenchTreent::create(entities));
+    for (size_t i = 1; i < count; ++i)
+    {
+      nodes.push_back(nodes[parents[i]].createChild());
+    }
+  }
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    nodes[i].component<OffsetComponent>()->setLocal(1.0f);
+    nodes[i].component<OpacityComponent>()->setLocal(0.5f);
+  }
+
+  auto &root = nodes.front();
+  auto offset = root.component<OffsetComponent>();
+  const auto repetitions = repetitionsFor(count);
+
+  {
+    Measurement m(shapeName(shape), count, "descend", count);
+    m.setRepetitions(repetitions);
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+      offset->descend();
+    }
+  }
+
+  {
+    Measurement m(shapeName(shape), count, "descendAll (rebuild)", count);
+    OffsetComponent::descendAll(entities);
+  }
+
+  {
+    Measurement m(shapeName(shape), count, "descendAll", count);
+    m.setRepetitions(repetitions);
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+      OffsetComponent::descendAll(entities);
+    }
+  }
+
+  {
+    Measurement m(shapeName(shape), count, "descendDirty (1%)", count);
+    m.setRepetitions(repetitions);
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+      for (size_t i = r % 100; i < count; i += 100)
+      {
+        nodes[i].component<OffsetComponent>()->markDirty();
+      }
+      OffsetComponent::descendDirty(entities);
+    }
+  }
+
+  {
+    volatile float sum = 0.0f;
+    Measurement m(shapeName(shape), count, "worldValue (clean)", sample.size());
+    for (auto i : sample)
+    {
+      sum = sum + nodes[i].component<OffsetComponent>()->worldValue();
+    }
+  }
+
+  {
+    volatile float sum = 0.0f;
+    for (size_t i = 0; i < count; i += 100)
+    {
+      nodes[i].component<OffsetComponent>()->markDirty();
+    }
+    Measurement m(shapeName(shape), count, "worldValue (1% dirty)", sample.size());
+    for (auto i : sample)
+    {
+      sum = sum + nodes[i].component<OffsetComponent>()->worldValue();
+    }
+  }
+
+  {
+    size_t visited = 0;
+    Measurement m(shapeName(shape), count, "visit", count);
+    m.setRepetitions(repetitions);
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+      root.visit([&visited] (BenchTreent &) { ++visited; });
+    }
+  }
+
+  {
+    volatile float sum = 0.0f;
+    Measurement m(shapeName(shape), count, "descendants", count);
+    m.setRepetitions(repetitions);
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+      auto span = root.descendants();
+      float total = 0.0f;
+      for (size_t i = 0; i < span.size(); ++i)
+      {
+        total += span.worlds()[i];
+      }
+      sum = sum + total;
+    }
+  }
+
+  {
+    size_t visited = 0;
+    Measurement m(shapeName(shape), count, "TreeView each", count);
+    m.setRepetitions(repetitions);
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+      treent::TreeView<OffsetComponent, OpacityComponent>(entities).eachInTrees([&visited] (entityx::Entity, OffsetComponent &, OpacityComponent &) { ++visited; });
+    }
+  }
+
+  {
+    Measurement m(shapeName(shape), count, "detach", sample.size());
+    for (auto i : sample)
+    {
+      nodes[i].detachFromParent();
+    }
+  }
+
+  {
+    Measurement m(shapeName(shape), count, "attach", sample.size());
+    for (auto i : sample)
+    {
+      auto child = nodes[i].entity();
+      nodes[parents[i]].appendChild(child);
+    }
+  }
+
+  {
+    Measurement m(shapeName(shape), count, "destroySubtree", count);
+    root.destroySubtree();
+  }
+  std::printf("\n");
+}
+
+/// Scoped ownership of \a count small trees: moving the handles, and tearing the trees
+/// down one ScopedTreent at a time versus all at once through a ScopedTreentGroup.
+void benchmarkOwnership(size_t count)
+{
+  entityx::EventManager events;
+  entityx::EntityManager entities(events);
+  const size_t treeSize = 10;
+  auto plant = [&entities] {
+    auto root = ScopedBenchTreent::create(entities);
+    for (size_t i = 1; i < treeSize; ++i)
+    {
+      root.createChild();
+    }
+    return root;
+  };
+
+  std::vector<ScopedBenchTreent> scoped;
+  scoped.reserve(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    scoped.push_back(plant());
+  }
+
+  {
+    std::vector<ScopedBenchTreent> moved;
+    moved.reserve(count);
+    {
+      Measurement m("scoped", count * treeSize, "ScopedTreent move", count);
+      for (auto &s : scoped)
+      {
+        moved.push_back(std::move(s));
+      }
+    }
+    scoped.swap(moved);
+  }
+
+  {
+    Measurement m("scoped", count * treeSize, "ScopedTreent destroy", count * treeSize);
+    scoped.clear();
+  }
+
+  BenchTreentGroup group;
+  group.reserve(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    group.add(plant());
+  }
+
+  {
+    Measurement m("scoped", count * treeSize, "group destroy", count * treeSize);
+    group.reset();
+  }
+  std::printf("\n");
+}
+
+/// Builds and tears down \a count fans whose child lists outgrow their inline storage.
+void buildAndDestroyFans(const char *label, size_t count)
+{
+  entityx::EventManager events;
+  entityx::EntityManager entities(events);
+  const size_t fanSize = 17;
+  std::vector<entityx::Entity> roots;
+  roots.reserve(count);
+
+  {
+    Measurement m(label, count * fanSize, "create", count * fanSize);
+    for (size_t i = 0; i < count; ++i)
+    {
+      auto root = BenchTreent::create(entities);
+      for (size_t j = 1; j < fanSize; ++j)
+      {
+        root.createChild();
+      }
+      roots.push_back(root.entity());
+    }
+  }
+
+  {
+    Measurement m(label, count * fanSize, "destroySubtrees", count * fanSize);
+    BenchTreent::destroySubtrees(roots);
+  }
+}
+
+/// Frames that edit 1% of the nodes and then read SampleSize world values: eager components
+/// run descendDirty() first, lazy components resolve the values they are asked for.
+void benchmarkEvaluation(size_t count)
+{
+  entityx::EventManager events;
+  entityx::EntityManager entities(events);
+  using EvaluationTreent = treent::TreentT<OffsetComponent, LazyOffsetComponent>;
+
+  const auto parents = makeParents(Shape::Random, count);
+  std::vector<EvaluationTreent> nodes;
+  nodes.reserve(count);
+  nodes.push_back(EvaluationTreent::create(entities));
+  for (size_t i = 1; i < count; ++i)
+  {
+    nodes.push_back(nodes[parents[i]].createChild());
+  }
+
+  // Both strategies see the same edits and reads, picked anew each frame.
+  const size_t frames = 100;
+  const size_t editCount = count / 100;
+  const size_t readCount = std::min(count, SampleSize);
+  std::mt19937 rng(static_cast<uint32_t>(count));
+  std::vector<size_t> edits(frames * editCount);
+  std::vector<size_t> reads(frames * readCount);
+  for (auto &i : edits) { i = rng() % count; }
+  for (auto &i : reads) { i = rng() % count; }
+  OffsetComponent::descendAll(entities);
+  volatile float sum = 0.0f;
+
+  {
+    Measurement m("eager", count, "frame (sparse reads)", readCount);
+    m.setRepetitions(frames);
+    for (size_t r = 0; r < frames; ++r)
+    {
+      for (size_t k = r * editCount; k < (r + 1) * editCount; ++k)
+      {
+        const auto i = edits[k];
+        nodes[i].component<OffsetComponent>()->setLocal(1.0f);
+      }
+      OffsetComponent::descendDirty(entities);
+      for (size_t k = r * readCount; k < (r + 1) * readCount; ++k)
+      {
+        const auto i = reads[k];
+        sum = sum + nodes[i].component<OffsetComponent>()->worldValue();
+      }
+    }
+  }
+
+  {
+    Measurement m("lazy", count, "frame (sparse reads)", readCount);
+    m.setRepetitions(frames);
+    for (size_t r = 0; r < frames; ++r)
+    {
+      for (size_t k = r * editCount; k < (r + 1) * editCount; ++k)
+      {
+        const auto i = edits[k];
+        nodes[i].component<LazyOffsetComponent>()->setLocal(1.0f);
+      }
+      for (size_t k = r * readCount; k < (r + 1) * readCount; ++k)
+      {
+        const auto i = reads[k];
+        sum = sum + nodes[i].component<LazyOffsetComponent>()->worldValue();
+      }
+    }
+  }
+
+  nodes.front().destroySubtree();
+  std::printf("\n");
+}
+
+#ifdef TREENT_BENCH_REFERENCE
+
+treent::Affine2d affine2dLocal(size_t i)
+{
+  return treent::Affine2d::trs(ci::vec2(float(i % 7), float(i % 5)), 0.01f * float(i % 13), ci::vec2(1.0f + 0.01f * float(i % 3)));
+}
+
+treent::Affine3d affine3dLocal(size_t i)
+{
+  const float half = 0.005f * float(i % 13);
+  return treent::Affine3d::trs(ci::vec3(float(i % 7), float(i % 5), float(i % 3)), ci::quat(std::cos(half), 0.0f, 0.0f, std::sin(half)), ci::vec3(1.0f + 0.01f * float(i % 3)));
+}
+
+/// A random tree of \a count reference affine components. TreeOrder keeps their matrices
+/// one per node, which descendAll() and worldValue() read whole; descendLevels() copies
+/// them into SoA lanes level by level for its SIMD kernels.
+template <typename Component>
+void benchmarkAffine(const char *label, size_t count, typename Component::Local (*makeLocal)(size_t))
+{
+  entityx::EventManager events;
+  entityx::EntityManager entities(events);
+  using AffineTreent = treent::TreentT<Component>;
+
+  const auto parents = makeParents(Shape::Random, count);
+  std::vector<AffineTreent> nodes;
+  nodes.reserve(count);
+  nodes.push_back(AffineTreent::create(entities));
+  for (size_t i = 1; i < count; ++i)
+  {
+    nodes.push_back(nodes[parents[i]].createChild());
+  }
+  for (size_t i = 0; i < count; ++i)
+  {
+    nodes[i].template component<Component>()->setLocal(makeLocal(i));
+  }
+  const auto repetitions = repetitionsFor(count);
+
+  {
+    Measurement m(label, count, "descendAll (rebuild)", count);
+    Component::descendAll(entities);
+  }
+
+  {
+    Measurement m(label, count, "descendAll", count);
+    m.setRepetitions(repetitions);
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+      Component::descendAll(entities);
+    }
+  }
+
+  {
+    Measurement m(label, count, "descendLevels", count);
+    m.setRepetitions(repetitions);
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+      Component::descendLevels(entities);
+    }
+  }
+
+  {
+    Measurement m(label, count, "descendDirty (1%)", count);
+    m.setRepetitions(repetitions);
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+      for (size_t i = r % 100; i < count; i += 100)
+      {
+        nodes[i].template component<Component>()->markDirty();
+      }
+      Component::descendDirty(entities);
+    }
+  }
+
+  {
+    volatile float sum = 0.0f;
+    const auto stride = std::max<size_t>(1, count / SampleSize);
+    Measurement m(label, count, "worldValue (clean)", count / stride);
+    for (size_t i = 0; i < count; i += stride)
+    {
+      sum = sum + nodes[i].template component<Component>()->worldValue().m[0];
+    }
+  }
+
+  nodes.front().destroySubtree();
+  std::printf("\n");
+}
+
+/// True when \a a and \a b hold the same floats, field for field.
+template <typename Component>
+bool sameWorld(const typename Component::World &a, const typename Component::World &b)
+{
+  using Batch = treent::BatchCompose<Component>;
+  float fieldsA[Batch::FieldCount], fieldsB[Batch::FieldCount];
+  float *lanesA[Batch::FieldCount], *lanesB[Batch::FieldCount];
+  for (size_t f = 0; f < Batch::FieldCount; ++f)
+  {
+    lanesA[f] = &fieldsA[f];
+    lanesB[f] = &fieldsB[f];
+  }
+  Batch::load(a, lanesA, 0);
+  Batch::load(b, lanesB, 0);
+  return std::equal(fieldsA, fieldsA + Batch::FieldCount, fieldsB);
+}
+
+/// Times both passes of Component over \a nodes, then checks that they agree.
+template <typename Component, typename Node>
+bool compareLevels(const char *label, entityx::EntityManager &entities, std::vector<Node> &nodes)
+{
+  const auto count = nodes.size();
+  const auto repetitions = repetitionsFor(count);
+  Component::descendAll(entities);
+  Component::descendLevels(entities);
+
+  {
+    Measurement m(label, count, "descendAll", count);
+    m.setRepetitions(repetitions);
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+      Component::descendAll(entities);
+    }
+  }
+
+  std::vector<typename Component::World> expected;
+  expected.reserve(count);
+  for (auto &node : nodes)
+  {
+    expected.push_back(node.template component<Component>()->world());
+  }
+
+  {
+    Measurement m(label, count, "descendLevels", count);
+    m.setRepetitions(repetitions);
+    for (size_t r = 0; r < repetitions; ++r)
+    {
+      Component::descendLevels(entities);
+    }
+  }
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (! sameWorld<Component>(nodes[i].template component<Component>()->world(), expected[i]))
+    {
+      std::printf("%s: descendLevels and descendAll differ at node %zu\n", label, i);
+      return false;
+    }
+  }
+  return true;
+}
+
+/// A forest of trees with one root, 10 children and 100 grandchildren each: few levels,
+/// each wide enough to fill SIMD lanes, the shape descendLevels() is meant for.
+bool benchmarkLevels(size_t count)
+{
+  entityx::EventManager events;
+  entityx::EntityManager entities(events);
+  using LevelTreent = treent::TreentT<treent::TransformComponent, treent::StyleComponent>;
+
+  const size_t treeSize = 111;
+  std::vector<LevelTreent> nodes;
+  std::vector<entityx::Entity> roots;
+  nodes.reserve(count);
+  while (nodes.size() + treeSize <= count)
+  {
+    auto root = LevelTreent::create(entities);
+    nodes.push_back(root);
+    roots.push_back(root.entity());
+    for (size_t c = 0; c < 10; ++c)
+    {
+      auto child = root.createChild();
+      nodes.push_back(child);
+      for (size_t g = 0; g < 10; ++g)
+      {
+        nodes.push_back(child.createChild());
+      }
+    }
+  }
+  for (size_t i = 0; i < nodes.size(); ++i)
+  {
+    nodes[i].component<treent::TransformComponent>()->setLocal(treent::Transform(ci::vec2(float(i % 7), float(i % 5)), 0.01f * float(i % 13)));
+    nodes[i].component<treent::StyleComponent>()->setLocal(treent::Style(0.5f + 0.05f * float(i % 10), ci::vec3(float(i % 3) * 0.5f)));
+  }
+
+  const bool same = compareLevels<treent::TransformComponent>("transform", entities, nodes)
+                 && compareLevels<treent::StyleComponent>("style", entities, nodes);
+  LevelTreent::destroySubtrees(roots);
+  std::printf("\n");
+  return same;
+}
+
+#endif
+
+/// Child lists from the heap, from a new TreeArena, and from the same arena once warm.
+void benchmarkArena(size_t count)
+{
+  buildAndDestroyFans("heap", count);
+  {
+    treent::TreeArena arena;
+    treent::TreeArena::Scope scope(arena);
+    buildAndDestroyFans("arena", count);
+    buildAndDestroyFans("warm", count);
+  }
+  std::printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+  const size_t maxNodes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  std::printf("%-9s %8s  %-22s %8s %10s %10s %9s\n\n", "shape", "nodes", "operation", "ops", "ms", "ns/op", "allocs/op");
+  for (auto shape : { Shape::Chain, Shape::Fan, Shape::Balanced, Shape::Random })
+  {
+    for (size_t count = 1000; count <= maxNodes; count *= 10)
+    {
+      benchmark(shape, count);
+    }
+  }
+  for (size_t count = 100; count * 10 <= maxNodes; count *= 10)
+  {
+    benchmarkOwnership(count);
+  }
+  for (size_t count = 100; count * 10 <= maxNodes; count *= 10)
+  {
+    benchmarkArena(count);
+  }
+  for (size_t count = 1000; count <= maxNodes; count *= 10)
+  {
+    benchmarkEvaluation(count);
+  }
+#ifdef TREENT_BENCH_REFERENCE
+  const auto affineNodes = std::min<size_t>(maxNodes, 100000);
+  benchmarkAffine<treent::Affine2dComponent>("affine2d", affineNodes, &affine2dLocal);
+  benchmarkAffine<treent::Affine3dComponent>("affine3d", affineNodes, &affine3dLocal);
+  if (! benchmarkLevels(affineNodes))
+  {
+    return 1;
+  }
+#endif
+  return 0;
+}